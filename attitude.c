@@ -0,0 +1,94 @@
+#include "attitude.h"
+
+#ifdef GYRO_MPU6050
+#include "settings.h"
+#include "sticks.h"
+
+/*** BEGIN VARIABLES ***/
+int32_t AttAngle[2];
+bool AttLevel;
+
+static uint8_t attSamples;           // MpuSamples at the last update
+/*** END VARIABLES ***/
+
+/*
+ * Gyro rate and accelerometer tilt, both signed as the control loop
+ * sees the gyro (after the gyro direction setting).
+ */
+static inline int16_t attRate(uint8_t axis)
+{
+  bool normal = axis == ROLL ? Config.RollGyroDirection == GYRO_NORMAL :
+    Config.PitchGyroDirection == GYRO_NORMAL;
+
+  return normal ? -gyroRate[axis] : gyroRate[axis];
+}
+
+static inline int32_t attTilt(uint8_t axis)
+{
+  bool normal = axis == ROLL ? Config.RollGyroDirection == GYRO_NORMAL :
+    Config.PitchGyroDirection == GYRO_NORMAL;
+  int16_t acc = axis == ROLL ? ATT_ROLL_ACC_SIGN * accADC[PITCH] :
+    ATT_PITCH_ACC_SIGN * accADC[ROLL];
+
+  return (int32_t)(normal ? -acc : acc) * ATT_ACC_SCALE;
+}
+
+/*
+ * Start from the accelerometer alone; call with the model still.
+ */
+void attitudeReset()
+{
+  ReadGyros();
+  attSamples = MpuSamples;
+  AttAngle[ROLL] = attTilt(ROLL);
+  AttAngle[PITCH] = attTilt(PITCH);
+}
+
+/*
+ * Integrate the gyro over the samples since the last call and pull
+ * towards the accelerometer tilt. Call after ReadGyros().
+ */
+void attitudeUpdate()
+{
+  uint8_t n = MpuSamples - attSamples;
+  int32_t g2;
+
+  if(!n)
+    return;
+  attSamples+= n;
+
+  AttAngle[ROLL]+= (int32_t)attRate(ROLL) * n;
+  AttAngle[PITCH]+= (int32_t)attRate(PITCH) * n;
+
+  g2 = (int32_t)accADC[ROLL] * accADC[ROLL] +
+    (int32_t)accADC[PITCH] * accADC[PITCH] +
+    (int32_t)accADC[YAW] * accADC[YAW];
+  if(g2 < ATT_ACC_MIN2 || g2 > ATT_ACC_MAX2)
+    return;
+
+  AttAngle[ROLL]+= (attTilt(ROLL) - AttAngle[ROLL]) >> ATT_ACC_SHIFT;
+  AttAngle[PITCH]+= (attTilt(PITCH) - AttAngle[PITCH]) >> ATT_ACC_SHIFT;
+}
+
+/*
+ * Angle mode outer loop: turn a stick position into a rate setpoint
+ * for the gyro loop, scaled by the same gain as the gyro so the two
+ * meet at the requested angle.
+ */
+int16_t attitudeLevel(uint8_t axis, int16_t stick, uint16_t gain)
+{
+  int32_t error, rate;
+
+  error = (int32_t)stick * (ATT_MAX_ANGLE * ATT_UNITS_PER_DEG / STICK_FULL) -
+    AttAngle[axis];
+  if(error > ATT_MAX_ERROR * ATT_UNITS_PER_DEG)
+    error = ATT_MAX_ERROR * ATT_UNITS_PER_DEG;
+  else if(error < -ATT_MAX_ERROR * ATT_UNITS_PER_DEG)
+    error = -ATT_MAX_ERROR * ATT_UNITS_PER_DEG;
+
+  // Full resolution gyro LSB: error * ATT_LEVEL_GAIN / MPU_RATE_HZ
+  rate = (error * ATT_LEVEL_SCALE) >> 16;
+
+  return (rate * gain) >> (GYRO_GAIN_SHIFT + MPU_GYRO_SHIFT);
+}
+#endif
@@ -0,0 +1,61 @@
+#ifndef ATTITUDE_H
+#define ATTITUDE_H
+
+#include "config.h"
+#include "gyros.h"
+#include "mpu6050.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Angles are the integral of gyroRate[] over MPU samples, so one unit
+ * is one gyro LSB for one sample period: 8200 units per degree.
+ */
+#define ATT_UNITS_PER_DEG ((int32_t)MPU_GYRO_LSB_X10 * MPU_RATE_HZ / 10)
+
+/*
+ * Accelerometer tilt uses sin(a) ~ a, good to about 5% at 30 degrees.
+ * 57.3 degrees per radian, rounded.
+ */
+#define ATT_ACC_SCALE ((ATT_UNITS_PER_DEG * 573 + 5 * MPU_ACC_1G) / (10L * MPU_ACC_1G))
+
+/*
+ * Sign of the accelerometer tilt relative to the gyro, by the right
+ * hand rule for the default MPU_*_AXIS mapping. Flip if remapped.
+ */
+#define ATT_ROLL_ACC_SIGN 1
+#define ATT_PITCH_ACC_SIGN -1
+
+/*
+ * Complementary filter: each sample moves the estimate 1/2^shift of
+ * the way to the accelerometer, a time constant of about 1s at 500Hz.
+ * Samples more than 15% away from 1g are not trusted.
+ */
+#define ATT_ACC_SHIFT 9
+#define ATT_ACC_MIN2 ((int32_t)MPU_ACC_1G * MPU_ACC_1G / 100 * 72)
+#define ATT_ACC_MAX2 ((int32_t)MPU_ACC_1G * MPU_ACC_1G / 100 * 132)
+
+/*
+ * Self-level: full stick asks for ATT_MAX_ANGLE, and the angle error
+ * gives a rate setpoint of ATT_LEVEL_GAIN deg/s per degree.
+ */
+#define ATT_MAX_ANGLE 45
+#define ATT_MAX_ERROR 60
+#define ATT_LEVEL_GAIN 5
+#define ATT_LEVEL_SCALE ((ATT_LEVEL_GAIN * 65536L + MPU_RATE_HZ / 2) / MPU_RATE_HZ)
+
+// Aux channel that switches self-level on (when RxInAux[] > 0)
+#define ATT_LEVEL_AUX 0
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern int32_t AttAngle[2];          // Roll, pitch, ATT_UNITS_PER_DEG
+extern bool AttLevel;
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void attitudeReset(void);
+void attitudeUpdate(void);
+int16_t attitudeLevel(uint8_t axis, int16_t stick, uint16_t gain);
+/*** END PROTOTYPES ***/
+
+#endif
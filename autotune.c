@@ -0,0 +1,179 @@
+#include "autotune.h"
+
+#ifdef AUTOTUNE
+#include "motors.h"
+#include "receiver.h"
+#include "settings.h"
+#include "sticks.h"
+#include "tpa.h"
+
+/*** BEGIN VARIABLES ***/
+bool AutotuneActive;
+uint8_t AutotuneAxis = AUTOTUNE_IDLE;
+int16_t AutotuneOutput;
+
+static uint8_t autotuneNext;         // Next axis to test, > YAW when done
+static bool autotuneRelayUp;         // Relay output is positive
+static uint8_t autotuneCycles;       // Completed cycles on this axis
+static uint16_t autotuneFrames;      // Frames in this cycle
+static uint16_t autotunePeriod;      // Sum of measured periods
+static uint16_t autotuneAmplitude;   // Sum of measured peak-to-peak
+static int16_t autotuneHigh, autotuneLow;
+static bool autotuneTuned;           // Results not yet saved
+static uint16_t autotuneGain[3];
+static uint16_t autotuneI[3];
+static uint16_t autotuneD[3];
+/*** END VARIABLES ***/
+
+void autotuneStart()
+{
+  AutotuneActive = true;
+  autotuneNext = ROLL;
+  for(uint8_t i = 0;i < 3;i++)
+    autotuneGain[i] = 0;
+}
+
+static uint16_t autotuneSqrt(uint32_t x)
+{
+  uint16_t r = 0;
+
+  for(uint16_t b = 0x8000;b;b>>= 1) {
+    if((uint32_t)(r | b) * (r | b) <= x)
+      r|= b;
+  }
+  return r;
+}
+
+static void autotuneRestart(void)
+{
+  autotuneCycles = 0;
+  autotuneFrames = 0;
+  autotunePeriod = 0;
+  autotuneAmplitude = 0;
+  autotuneHigh = 0;
+  autotuneLow = 0;
+}
+
+/*
+ * Ziegler-Nichols PID from the averaged cycle. The stabilizer error
+ * already carries the P gain, so I and D are stored as Q8 multipliers
+ * per frame: Ti = Tu / 2 gives 2 / Nu, Td = Tu / 8 gives Nu / 8,
+ * where Nu is the period in frames.
+ *
+ * P is stored as a GainInADC[] equivalent: output = gyro * gain >>
+ * GYRO_GAIN_SHIFT, so gain = 0.6 Ku << GYRO_GAIN_SHIFT, divided by
+ * the gain schedule at this throttle so that TPA gives back Kp here.
+ */
+static void autotuneCompute(uint8_t axis, int16_t collective)
+{
+  uint16_t period = autotunePeriod >> AUTOTUNE_CYCLES_SHIFT;
+  uint16_t a = autotuneAmplitude >> (AUTOTUNE_CYCLES_SHIFT + 1);
+  uint16_t tpa = tpaPercent(axis, collective);
+  uint32_t gain;
+
+  if(a <= AUTOTUNE_HYSTERESIS || !period || !tpa)
+    return;
+  a = autotuneSqrt((uint32_t)a * a - AUTOTUNE_HYSTERESIS * AUTOTUNE_HYSTERESIS);
+
+  // 0.6 * 4 / pi * 32 * 100 = 2445
+  gain = ((uint32_t)AUTOTUNE_RELAY * 2445 << (GYRO_GAIN_SHIFT - 5)) /
+    ((uint32_t)a * tpa);
+  if(gain < 1)
+    gain = 1;
+  else if(gain > AUTOTUNE_GAIN_MAX)
+    gain = AUTOTUNE_GAIN_MAX;
+
+  autotuneGain[axis] = gain;
+  autotuneI[axis] = (512 + period / 2) / period;
+  autotuneD[axis] = period * 32;
+  autotuneTuned = true;
+}
+
+/*
+ * Run the relay for one frame, before the sticks are scaled. gyroADC[]
+ * must be zeroed but not yet gain scaled. Sets AutotuneAxis and
+ * AutotuneOutput for the mixer.
+ */
+void autotuneStep()
+{
+  uint8_t axis = autotuneNext;
+  int16_t x, stick;
+  bool normal;
+
+  AutotuneAxis = AUTOTUNE_IDLE;
+  if(axis > YAW)
+    return;
+
+  stick = axis == ROLL ? RxInRoll : axis == PITCH ? RxInPitch : RxInYaw;
+  if(RxInCollective < AUTOTUNE_MIN_COLLECTIVE || abs(stick) > AUTOTUNE_STICK) {
+    autotuneRestart();
+    return;
+  }
+
+  // Gyro as the stabilizer sees it, before gain
+  normal = axis == ROLL ? Config.RollGyroDirection == GYRO_NORMAL :
+    axis == PITCH ? Config.PitchGyroDirection == GYRO_NORMAL :
+    Config.YawGyroDirection == GYRO_NORMAL;
+  x = normal ? -gyroADC[axis] : gyroADC[axis];
+
+  if(x > autotuneHigh)
+    autotuneHigh = x;
+  if(x < autotuneLow)
+    autotuneLow = x;
+
+  if(autotuneRelayUp && x > AUTOTUNE_HYSTERESIS) {
+    autotuneRelayUp = false;
+  } else if(!autotuneRelayUp && x < -AUTOTUNE_HYSTERESIS) {
+    // One full cycle ends at each upward switch
+    autotuneRelayUp = true;
+    if(++autotuneCycles > AUTOTUNE_SKIP) {
+      autotunePeriod+= autotuneFrames;
+      autotuneAmplitude+= autotuneHigh - autotuneLow;
+    }
+    autotuneFrames = 0;
+    autotuneHigh = 0;
+    autotuneLow = 0;
+
+    if(autotuneCycles == AUTOTUNE_SKIP + AUTOTUNE_CYCLES) {
+      autotuneCompute(axis, RxInCollective);
+      autotuneNext++;
+      autotuneRestart();
+      return;
+    }
+  }
+
+  if(++autotuneFrames > AUTOTUNE_MAX_PERIOD) {
+    autotuneNext++;                  // No oscillation, leave untuned
+    autotuneRestart();
+    return;
+  }
+
+  AutotuneAxis = axis;
+  AutotuneOutput = autotuneRelayUp ? AUTOTUNE_RELAY : -AUTOTUNE_RELAY;
+}
+
+/*
+ * Store the results; call when disarmed, as the EEPROM write takes
+ * milliseconds.
+ */
+void autotuneFinish()
+{
+  AutotuneAxis = AUTOTUNE_IDLE;
+  if(!autotuneTuned)
+    return;
+  autotuneTuned = false;
+
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    if(!autotuneGain[i])
+      continue;
+    Config.TunedGain[i] = autotuneGain[i];
+    Config.TunedI[i] = autotuneI[i];
+    Config.TunedD[i] = autotuneD[i];
+  }
+  Save_Config_to_EEPROM();
+
+  ReadGainPots();
+  sticksBuildCurves();
+  tpaBuildTable();
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "config.h"
+#include "gyros.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Relay-feedback autotune. Entered from the pitch + roll pot boot
+ * gesture; then arm and hover. Each axis in turn is driven by a relay
+ * of +-AUTOTUNE_RELAY on the sign of its gyro, and the period Tu and
+ * amplitude a of the resulting oscillation give the ultimate gain
+ * Ku = 4d / (pi sqrt(a^2 - e^2)). Ziegler-Nichols PID gains are
+ * stored in Config on the next disarm and replace the gain pots.
+ * Moving the stick of the axis under test restarts it; lowering the
+ * throttle pauses.
+ */
+#ifndef MINIMAL
+#define AUTOTUNE
+#endif
+
+#define AUTOTUNE_RELAY 100           // Output units
+#define AUTOTUNE_HYSTERESIS 4        // Gyro units (e)
+#define AUTOTUNE_MIN_COLLECTIVE 300  // Only run above this throttle
+#define AUTOTUNE_STICK (STICK_FULL / 5)  // Stick movement that restarts
+#define AUTOTUNE_SKIP 3              // Cycles to settle
+#define AUTOTUNE_CYCLES 8            // Cycles to measure, power of two
+#define AUTOTUNE_CYCLES_SHIFT 3
+#define AUTOTUNE_MAX_PERIOD (ESC_RATE * 2)  // Frames, else give up
+#define AUTOTUNE_GAIN_MAX 4095
+
+#define AUTOTUNE_IDLE 0xff           // AutotuneAxis when not testing
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern bool AutotuneActive;
+extern uint8_t AutotuneAxis;         // Axis under test
+extern int16_t AutotuneOutput;       // Relay output for that axis
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void autotuneStart(void);
+void autotuneStep(void);
+void autotuneFinish(void);
+/*** END PROTOTYPES ***/
+
+#endif
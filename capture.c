@@ -0,0 +1,104 @@
+#include "capture.h"
+
+#ifdef CAPTURE
+#include <string.h>
+#include "receiver.h"
+#ifdef GYRO_MPU6050
+#include "attitude.h"
+#endif
+
+/*** BEGIN VARIABLES ***/
+static bool captureActive;           // Between arming and disarm
+static uint8_t captureSeq;
+#ifdef GYRO_MPU6050
+static int32_t captureAngle[2];      // As last sent
+static bool captureWhole;            // Send the next angles whole
+#endif
+/*** END VARIABLES ***/
+
+/*
+ * Send what the compute stage reads besides the per-frame inputs.
+ * Called on arming, after the gains and tables are rebuilt; the
+ * motors are stopped, so waiting for the link here is harmless.
+ */
+void captureStart()
+{
+  struct captureStart start;
+  uint8_t chunk[1 + CAPTURE_CHUNK];
+  const uint8_t *p = (const uint8_t *)&start;
+
+  start.gain[ROLL] = GainInADC[ROLL];
+  start.gain[PITCH] = GainInADC[PITCH];
+  start.gain[YAW] = GainInADC[YAW];
+  start.pot[ROLL] = GainPotADC[ROLL];
+  start.pot[PITCH] = GainPotADC[PITCH];
+  start.pot[YAW] = GainPotADC[YAW];
+  start.config = Config;
+
+  for(uint8_t offset = 0;offset < sizeof(start);offset+= CAPTURE_CHUNK) {
+    uint8_t length = sizeof(start) - offset;
+
+    if(length > CAPTURE_CHUNK)
+      length = CAPTURE_CHUNK;
+    chunk[0] = offset;
+    memcpy(&chunk[1], p + offset, length);
+    telemetryFlush();
+    telemetrySend(TELEMETRY_CAPTURE_START, chunk, 1 + length);
+  }
+
+  captureSeq = 0;
+#ifdef GYRO_MPU6050
+  captureWhole = true;
+#endif
+  captureActive = true;
+}
+
+/*
+ * Send this frame's compute stage inputs. Called every loop, between
+ * loopInputs() and loopCompute(); the frame with the disarm is the
+ * last one sent.
+ */
+void captureFrame(bool armed)
+{
+  struct captureFrame frame;
+  uint8_t length = sizeof(frame);
+#ifdef GYRO_MPU6050
+  int32_t roll = AttAngle[0] - captureAngle[0];
+  int32_t pitch = AttAngle[1] - captureAngle[1];
+#endif
+
+  if(!captureActive)
+    return;
+
+  frame.seq = captureSeq++ & CAPTURE_SEQ_MASK;
+  if(armed)
+    frame.seq|= CAPTURE_ARMED;
+  frame.rx[0] = RxInRoll;
+  frame.rx[1] = RxInPitch;
+  frame.rx[2] = RxInCollective;
+  frame.rx[3] = RxInYaw;
+  frame.gyro[ROLL] = gyroADC[ROLL];
+  frame.gyro[PITCH] = gyroADC[PITCH];
+  frame.gyro[YAW] = gyroADC[YAW];
+#ifdef GYRO_MPU6050
+  if(AttLevel)
+    frame.seq|= CAPTURE_LEVEL;
+  if(captureWhole || roll != (int16_t)roll || pitch != (int16_t)pitch) {
+    frame.angle.whole[0] = AttAngle[0];
+    frame.angle.whole[1] = AttAngle[1];
+    captureWhole = false;
+  } else {
+    frame.angle.change[0] = roll;
+    frame.angle.change[1] = pitch;
+    length-= sizeof(frame.angle.whole) - sizeof(frame.angle.change);
+  }
+  captureAngle[0] = AttAngle[0];
+  captureAngle[1] = AttAngle[1];
+#endif
+
+  telemetrySend(TELEMETRY_CAPTURE_FRAME, &frame, length);
+
+  if(!armed)
+    captureActive = false;
+}
+#endif
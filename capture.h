@@ -0,0 +1,104 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "config.h"
+#include "gyros.h"
+#include "motors.h"
+#include "serialrx.h"
+#include "settings.h"
+#include "spectrum.h"
+#include "telemetry.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Flight capture for replay. From each arming to the following
+ * disarm, the inputs of the control loop's compute stage (see
+ * loopCompute() in loop.c) are sent as telemetry records, one per
+ * frame. Together with the start record this is everything the
+ * compute stage reads, so running the same code on a host over a
+ * capture reproduces MotorOut[] exactly.
+ *
+ * Records:
+ *   TELEMETRY_CAPTURE_START  offset, chunk of struct captureStart
+ *                            (sent at arming, in order, before any
+ *                            frame record)
+ *   TELEMETRY_CAPTURE_FRAME  struct captureFrame, every loop
+ *
+ * The sequence number in the frame record shows dropped records; a
+ * replay is only exact up to the first gap. test/replay_test.c is a
+ * host replay of a capture.
+ */
+//#define CAPTURE
+
+#if defined(CAPTURE) && !defined(TELEMETRY)
+#error "CAPTURE needs TELEMETRY, which needs a serial receiver (RX_MODE) and no MINIMAL"
+#endif
+
+#if defined(CAPTURE) && defined(SPECTRUM)
+#error "CAPTURE and SPECTRUM share the telemetry link, define only one"
+#endif
+
+#define CAPTURE_CHUNK 32             // Start record bytes per telemetry record
+
+// Frame record seq byte: a 6-bit frame count and the flags
+#define CAPTURE_SEQ_MASK 0x3f
+#define CAPTURE_ARMED _BV(6)
+#define CAPTURE_LEVEL _BV(7)         // AttLevel (self-level)
+
+/*
+ * Every frame must be sent, so the link has to keep up with ESC_RATE
+ * (SBUS is 12 bits per byte, Spektrum 10). CAPTURE_RECORD is a frame
+ * record with its framing; keep it in step with struct captureFrame.
+ * The MPU-6050 angles go as changes from the last frame, 4 bytes; the
+ * first frame, and any change too big for 16 bits, sends them whole
+ * in a longer record (CAPTURE_RECORD + 4), which the transmit buffer
+ * takes up over the next frames.
+ *
+ * Supported at ESC_RATE 450: Spektrum with either gyro. SBUS needs
+ * ESC_RATE 400 or less with the analog gyros, 350 or less with the
+ * MPU-6050.
+ */
+#ifdef GYRO_MPU6050
+#define CAPTURE_RECORD (15 + 4 + 4)
+#else
+#define CAPTURE_RECORD (15 + 4)
+#endif
+
+#if RX_MODE == RX_SBUS
+#define CAPTURE_LINK_BYTES (SBUS_BAUD / 12)
+#else
+#define CAPTURE_LINK_BYTES (SPEKTRUM_BAUD / 10)
+#endif
+
+#if defined(CAPTURE) && CAPTURE_RECORD * ESC_RATE > CAPTURE_LINK_BYTES
+#error "CAPTURE frame records do not fit the link at this ESC_RATE (see capture.h)"
+#endif
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+struct captureStart {
+  uint16_t gain[3];                  // GainInADC[] after arming
+  uint16_t pot[3];                   // GainPotADC[] (stick curves)
+  struct config config;
+};
+
+struct captureFrame {
+  uint8_t seq;                       // Frame count and flags, see above
+  int16_t rx[4];                     // RxInRoll, Pitch, Collective, Yaw
+                                     // (RxInOrgPitch is rx[1] >> 1)
+  int16_t gyro[3];                   // gyroADC[] less gyroZero[]
+#ifdef GYRO_MPU6050
+  union {
+    int16_t change[2];               // AttAngle[] less the last frame's
+    int32_t whole[2];                // AttAngle[], in a longer record
+  } angle;
+#endif
+};
+/*** END TYPES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void captureStart(void);
+void captureFrame(bool armed);
+/*** END PROTOTYPES ***/
+
+#endif
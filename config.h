@@ -11,7 +11,24 @@
 #include "typedefs.h"
 #include "io_cfg.h"
 
-/* Multicopter Type */
+/*
+ * Minimal build for 4KB flash / 512B RAM parts (ATmega48, set by the
+ * MCU). Drops the optional subsystems (autotune, notch, telemetry,
+ * runtime frame selection), shrinks the RAM tables and rules out the
+ * MPU-6050. "make report" shows what each module costs.
+ */
+//#define MINIMAL
+
+#if defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || \
+    defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48PA__)
+#define MINIMAL
+#endif
+
+/*
+ * Default multicopter type (selectable at runtime, see mixer.h).
+ * "make COPTER=..." (as in make report) defines one instead.
+ */
+#ifndef COPTER_FROM_MAKE
 //#define SINGLE_COPTER
 //#define DUAL_COPTER
 //#define TWIN_COPTER
@@ -21,5 +38,8 @@
 //#define Y4_COPTER
 //#define HEX_COPTER
 //#define Y6_COPTER
+//#define OCTO_COPTER
+//#define X8_COPTER
+#endif
 
 #endif
\ No newline at end of file
@@ -1,20 +1,41 @@
 #include "gyros.h"
 
+#include "motors.h"
 #include "receiver.h"
 #include "settings.h"
+#include "timers.h"
+#ifdef GYRO_MPU6050
+#include "mpu6050.h"
+#endif
 
-uint16_t GainInADC[3];        // ADC result
+uint16_t GainPotADC[3];       // ADC result
+uint16_t GainInADC[3];        // Gain in use
 int16_t  gyroADC[3];          // Holds Gyro ADC's
 int16_t  gyroZero[3];         // used for calibrating Gyros on ground
+#ifdef GYRO_MPU6050
+int16_t  gyroRate[3];
+int16_t  accADC[3];
+
+static int16_t gyroBias[3];   // Full resolution zero
+#endif
 
 void init_adc()
 {
+#ifdef GYRO_MPU6050
+  DIDR0  = _BV(ADC3D);   // Only the roll pot is analog, PC0/PC4/PC5 are digital
+#else
   DIDR0  = 0b00111111;  // Digital Input Disable Register - ADC5..0 Digital Input Disable
+#endif
   ADCSRB  = 0b00000000;  // ADC Control and Status Register B - ADTS2:0
 }
 
 void gyrosSetup()
 {
+#ifdef GYRO_MPU6050
+  GAIN_ROLL_DIR   = INPUT;
+
+  init_adc();
+#else
   GYRO_YAW_DIR    = INPUT;
   GYRO_PITCH_DIR  = INPUT;
   GYRO_ROLL_DIR   = INPUT;
@@ -23,6 +44,7 @@ void gyrosSetup()
   GAIN_ROLL_DIR   = INPUT;
   
   init_adc();
+#endif
 }
 
 
@@ -44,15 +66,50 @@ void read_adc(uint8_t channel)
 void ReadGainPots()
 {
   read_adc(3);      // read roll gain ADC3
-  GainInADC[ROLL] = GAIN_POT_REVERSE ADCW;
+  GainPotADC[ROLL] = GAIN_POT_REVERSE ADCW;
 
+#ifdef GYRO_MPU6050
+  GainPotADC[PITCH] = GainPotADC[ROLL];
+  GainPotADC[YAW] = GainPotADC[ROLL];
+#else
   read_adc(4);      // read pitch gain ADC4
-  GainInADC[PITCH] = GAIN_POT_REVERSE ADCW;
+  GainPotADC[PITCH] = GAIN_POT_REVERSE ADCW;
 
   read_adc(5);      // read yaw gain ADC5
-  GainInADC[YAW] = GAIN_POT_REVERSE ADCW;
+  GainPotADC[YAW] = GAIN_POT_REVERSE ADCW;
+#endif
+
+  // Autotuned gains replace the pots
+  for(uint8_t i = ROLL;i <= YAW;i++)
+#ifdef AUTOTUNE
+    GainInADC[i] = Config.TunedGain[i] ? Config.TunedGain[i] : GainPotADC[i];
+#else
+    GainInADC[i] = GainPotADC[i];
+#endif
 }
 
+#ifdef GYRO_MPU6050
+void ReadGyros()
+{
+  mpuRead();
+
+  gyroRate[ROLL] = MpuGyro[MPU_ROLL_AXIS] - gyroBias[ROLL];
+  gyroRate[PITCH] = MpuGyro[MPU_PITCH_AXIS] - gyroBias[PITCH];
+  gyroRate[YAW] = MpuGyro[MPU_YAW_AXIS] - gyroBias[YAW];
+
+  gyroADC[ROLL] = gyroRate[ROLL] >> MPU_GYRO_SHIFT;
+  gyroADC[PITCH] = gyroRate[PITCH] >> MPU_GYRO_SHIFT;
+#ifdef EXTERNAL_YAW_GYRO
+  gyroADC[YAW] = 0;
+#else
+  gyroADC[YAW] = gyroRate[YAW] >> MPU_GYRO_SHIFT;
+#endif
+
+  accADC[ROLL] = MpuAcc[MPU_ROLL_AXIS];
+  accADC[PITCH] = MpuAcc[MPU_PITCH_AXIS];
+  accADC[YAW] = MpuAcc[MPU_YAW_AXIS];
+}
+#else
 void ReadGyros()
 {
   read_adc(2);      // read roll gyro ADC2
@@ -68,8 +125,43 @@ void ReadGyros()
   gyroADC[YAW] = ADCW;
 #endif
 }
+#endif
+
+#ifdef GYRO_MPU6050
+/*
+ * The zero is kept at full sensor resolution and removed in
+ * ReadGyros(), so gyroZero[] stays 0. False, and no zero, if the
+ * sensor stops sending samples (see mpuWaitSample()); at most
+ * MPU_WAIT_US more than the 16 samples take, well within the
+ * watchdog timeout.
+ */
+bool CalibrateGyros()
+{
+  int32_t sum[3] = { 0, 0, 0 };
+
+  ReadGainPots();
+
+  for(uint8_t i = 0;i < 3;i++) {
+    gyroBias[i] = 0;
+    gyroZero[i] = 0;
+  }
+
+  for(uint8_t i = 0;i < 16;i++) {
+    if(!mpuWaitSample())
+      return false;
+    ReadGyros();
 
-void CalibrateGyros()
+    sum[ROLL]+= gyroRate[ROLL];
+    sum[PITCH]+= gyroRate[PITCH];
+    sum[YAW]+= gyroRate[YAW];
+  }
+
+  for(uint8_t i = 0;i < 3;i++)
+    gyroBias[i] = (sum[i] + 8) >> 4;
+  return true;
+}
+#else
+bool CalibrateGyros()
 {
   uint8_t i;
 
@@ -91,26 +183,25 @@ void CalibrateGyros()
   gyroZero[ROLL] = (gyroZero[ROLL] + 8) >> 4;
   gyroZero[PITCH] = (gyroZero[PITCH] + 8) >> 4;
   gyroZero[YAW] = (gyroZero[YAW] + 8) >> 4;
+  return true;
 }
+#endif
 
 void gyrosReverse()
 {
-  // flash LED 3 times
-  for(uint8_t i = 0;i < 3;i++) {
-    LED = 1;
-    _delay_ms(25);
-    LED = 0;
-    _delay_ms(25);
-  }
+  timersFlash(3);
 
   while(1) {
+    motorsStopFrame();
     RxGetChannels();
+    if(timersFlashing())
+      continue;
 
     if(RxInRoll < -STICK_THROW) {  // normal(left)
       Config.RollGyroDirection = GYRO_NORMAL;
       Save_Config_to_EEPROM();
       LED = 1;
-    } if(RxInRoll > STICK_THROW) {  // reverse(right)
+    } else if(RxInRoll > STICK_THROW) {  // reverse(right)
       Config.RollGyroDirection = GYRO_REVERSED;
       Save_Config_to_EEPROM();
       LED = 1;
@@ -130,10 +221,11 @@ void gyrosReverse()
       Config.YawGyroDirection = GYRO_REVERSED;
       Save_Config_to_EEPROM();
       LED = 1;
+    } else if(LED && !timersRunning(TIMER_MODE)) {
+      timersStart(TIMER_MODE, TIMER_MS(50), 0);
     }
 
-    _delay_ms(50);
-    LED = 0;
-
+    if(timersFired(TIMER_MODE))
+      LED = 0;
   }
 }
@@ -12,6 +12,18 @@
 // Skip yaw gyro calculations if using external yaw gyro
 //#define EXTERNAL_YAW_GYRO
 
+/*
+ * Use an MPU-6050 on the TWI bus instead of the analog gyros (see
+ * mpu6050.h). SDA/SCL share PC4/PC5 with the pitch and yaw gain pots,
+ * so the roll pot sets the gain for all three axes; the bus needs
+ * external pull-ups. Data-ready goes to PC0 (the yaw gyro input).
+ */
+//#define GYRO_MPU6050
+
+#if defined(GYRO_MPU6050) && defined(MINIMAL)
+#error "GYRO_MPU6050 does not fit the MINIMAL build"
+#endif
+
 #define ADC_MAX 1023
 /*** END DEFINES ***/
 
@@ -30,9 +42,14 @@ enum GyroArrayIndex { ROLL = 0, PITCH, YAW };
 /*** END TYPES ***/
 
 /*** BEGIN VARIABLES ***/
-extern uint16_t GainInADC[3];        // ADC result
+extern uint16_t GainPotADC[3];       // Gain pot ADC result
+extern uint16_t GainInADC[3];        // Gain in use (pot or autotuned)
 extern int16_t  gyroADC[3];          // Holds Gyro ADC's
 extern int16_t  gyroZero[3];         // used for calibrating Gyros on ground
+#ifdef GYRO_MPU6050
+extern int16_t  gyroRate[3];         // Full resolution, zero removed
+extern int16_t  accADC[3];           // Accelerometer, MPU_ACC_1G per g
+#endif
 /*** END VARIABLES ***/
 
 /*** BEGIN PROTOTYPES ***/
@@ -40,7 +57,7 @@ void init_adc(void);
 void read_adc(uint8_t channel);
 void ReadGainPots(void);
 void ReadGyros(void);
-void CalibrateGyros(void);
+bool CalibrateGyros(void);
 void gyrosSetup(void);
 void gyrosReverse(void);
 /*** END PROTOTYPES ***/
@@ -18,6 +18,22 @@
 #define RX_PITCH_DIR	REGISTER_BIT(DDRD,2)
 #define RX_COLL_DIR	REGISTER_BIT(DDRD,3)
 #define RX_YAW_DIR	REGISTER_BIT(DDRB,7)
+#define RX_ROLL_BIT	PD1
+#define RX_YAW_BIT	PB7
+
+// Optional auxiliary Rx channels on spare pin-change pins
+#define RX_AUX1		REGISTER_BIT(PIND,4)  // PCINT20
+#define RX_AUX2		REGISTER_BIT(PIND,0)  // PCINT16
+#define RX_AUX3		REGISTER_BIT(PINB,3)  // PCINT3 (MOSI)
+#define RX_AUX4		REGISTER_BIT(PINB,4)  // PCINT4 (MISO)
+#define RX_AUX1_DIR	REGISTER_BIT(DDRD,4)
+#define RX_AUX2_DIR	REGISTER_BIT(DDRD,0)
+#define RX_AUX3_DIR	REGISTER_BIT(DDRB,3)
+#define RX_AUX4_DIR	REGISTER_BIT(DDRB,4)
+#define RX_AUX1_BIT	PD4
+#define RX_AUX2_BIT	PD0
+#define RX_AUX3_BIT	PB3
+#define RX_AUX4_BIT	PB4
 
 #define GYRO_ROLL	REGISTER_BIT(PINC,2)
 #define GYRO_PITCH	REGISTER_BIT(PINC,1)
@@ -26,6 +42,10 @@
 #define GYRO_PITCH_DIR	REGISTER_BIT(DDRC,1)
 #define GYRO_YAW_DIR	REGISTER_BIT(DDRC,0)
 
+// MPU-6050 data-ready, in place of the yaw gyro
+#define MPU_INT		REGISTER_BIT(PINC,0)  // PCINT8
+#define MPU_INT_DIR	REGISTER_BIT(DDRC,0)
+
 #define GAIN_ROLL	REGISTER_BIT(PINC,3)
 #define GAIN_PITCH	REGISTER_BIT(PINC,4)
 #define GAIN_YAW	REGISTER_BIT(PINC,5)
@@ -39,12 +59,16 @@
 #define M4		REGISTER_BIT(PORTD,7)
 #define M5		REGISTER_BIT(PORTD,6)
 #define M6		REGISTER_BIT(PORTD,5)
+#define M7		REGISTER_BIT(PORTB,3)  // MOSI, shared with Rx aux 3
+#define M8		REGISTER_BIT(PORTB,4)  // MISO, shared with Rx aux 4
 #define M1_DIR		REGISTER_BIT(DDRB,2)
 #define M2_DIR		REGISTER_BIT(DDRB,1)
 #define M3_DIR		REGISTER_BIT(DDRB,0)
 #define M4_DIR		REGISTER_BIT(DDRD,7)
 #define M5_DIR		REGISTER_BIT(DDRD,6)
 #define M6_DIR		REGISTER_BIT(DDRD,5)
+#define M7_DIR		REGISTER_BIT(DDRB,3)
+#define M8_DIR		REGISTER_BIT(DDRB,4)
 
 #define LED		REGISTER_BIT(PORTB,6)
 #define LED_DIR		REGISTER_BIT(DDRB,6)
@@ -3,24 +3,48 @@
 #include "settings.h"
 #include "receiver.h"
 #include "motors.h"
-
-bool Armed;
-
-static int16_t integral[3];          // PID integral term
-static int16_t last_error[3];        // Last proportional error
+#include "mixer.h"
+#include "sticks.h"
+#include "tpa.h"
+#include "spectrum.h"
+#include "notch.h"
+#include "autotune.h"
+#include "capture.h"
+#include "stabilizer.h"
+#include "timers.h"
+#include "latency.h"
+#include "loop.h"
+#ifdef GYRO_MPU6050
+#include "mpu6050.h"
+#include "attitude.h"
+#endif
 
 static void setup(void);
+static void loopInputs(void);
 static void loop(void);
 int main(void);
 
 static void setup()
 {
+  /*
+   * A watchdog reset leaves the watchdog running; keep the cause for
+   * telemetry and stop it until the ESCs are being fed.
+   */
+  MotorDeadline.resetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+
   MCUCR = _BV(PUD);  // Disable hardware pull-up
 
   receiverSetup();
+#ifdef TELEMETRY
+  telemetrySetup();
+#endif
   gyrosSetup();
   motorsSetup();
   settingsSetup();
+  receiverBuildScales();
+  mixerSetup();
 
   LED_DIR   = OUTPUT;
   LED    = 0;
@@ -32,442 +56,158 @@ static void setup()
   if(OSCCAL == 0x9d)
     OSCCAL = 0x9f;
 
-  /*
-   * timer2 8bit - run at 8MHz / 1024 = 7812.5KHz, just used for arming
-   */
-  TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
-
   Armed = false;
 
+  sei();
+
   /*
-   * Flash the LED once at power on
+   * Flash the LED once at power on. The ESCs get stopped frames from
+   * here on, also while the gyros settle.
    */
   LED = 1;
-  _delay_ms(150);
+  motorsStopWait(TIMER_MS(150));
   LED = 0;
 
-  sei();
+#ifdef GYRO_MPU6050
+  mpuSetup();
+#endif
+
+  motorsStopWait(TIMER_MS(1500));
 
-  _delay_ms(1500);
+  /*
+   * From here on every mode makes frames, and output_motor_ppm()
+   * resets the watchdog (see MOTOR_WDT_TIMEOUT).
+   */
+  wdt_enable(MOTOR_WDT_TIMEOUT);
+#ifdef TELEMETRY
+  timersStart(TIMER_TELEMETRY, TIMER_MS(TIMERS_TELEMETRY_MS), TIMER_MS(TIMERS_TELEMETRY_MS));
+#endif
 
   ReadGainPots();
   ReadGainPots();
-  bool pitchMin = (GainInADC[PITCH] < (ADC_MAX * 5) / 100);    // 5% threshold
-  bool rollMin =  (GainInADC[ROLL]  < (ADC_MAX * 5) / 100);    // 5% threshold
-  bool yawMin =   (GainInADC[YAW]   < (ADC_MAX * 5) / 100);    // 5% threshold
+  sticksBuildCurves();
+  tpaBuildTable();
+  bool pitchMin = (GainPotADC[PITCH] < (ADC_MAX * 5) / 100);    // 5% threshold
+  bool rollMin =  (GainPotADC[ROLL]  < (ADC_MAX * 5) / 100);    // 5% threshold
+  bool yawMin =   (GainPotADC[YAW]   < (ADC_MAX * 5) / 100);    // 5% threshold
+#ifdef GYRO_MPU6050
+  /*
+   * No pitch/yaw pots. With the roll pot at minimum, the pitch stick
+   * held over at power on stands in for the pitch pot, for autotune.
+   */
+  timersStart(TIMER_MODE, TIMER_MS(100), 0);
+  while(!timersFired(TIMER_MODE)) {
+    motorsStopFrame();
+    RxGetChannels();
+  }
+  pitchMin = rollMin && abs(RxInPitch) > STICK_THROW;
+  yawMin = false;
+#endif
 
   if(pitchMin && rollMin && yawMin) { settingsClearAll(); }             // Clear config
   else if(pitchMin && yawMin)       { motorsIdentify(); }               // Motor identification
-//  else if(pitchMin && rollMin)      { }                                 // Future use
-//  else if(rollMin && yawMin)        { }                                 // Future use
-  else if(pitchMin)                 { receiverStickCenter(); }          // Stick Centering Test
+#ifdef AUTOTUNE
+  else if(pitchMin && rollMin)      { autotuneStart(); }                // Relay autotune in flight
+#endif
+#ifdef SPECTRUM
+  else if(rollMin && yawMin)        { spectrumStart(); }                // Vibration spectrum telemetry
+#endif
+  else if(pitchMin)                 { receiverCalibrate(); }            // Rx endpoint calibration
   else if(rollMin)                  { gyrosReverse(); }                 // Gyro direction reversing
   else if(yawMin)                   { motorsThrottleCalibration(); }    // ESC throttle calibration
 }
 
-static inline void loop()
+/*
+ * Input stage: everything that touches the hardware or the clock.
+ * Reads the receiver and gyros, handles arming and leaves the
+ * compute stage inputs in RxIn*, gyroADC[] (zero removed) and Armed.
+ */
+static inline void loopInputs()
 {
-  static uint16_t Change_Arming = 0;
-  static uint8_t Arming_TCNT2 = 0;
-  int16_t error, emax = 1023;
-  int16_t imax, derivative;
+  bool hold;
 
   RxGetChannels();
 
-  if(RxInCollective <= 0) {
-    // Check for stick arming (Timer2 at 8MHz/1024 = 7812.5KHz)
-    Change_Arming += (uint8_t)(TCNT2 - Arming_TCNT2);
-    Arming_TCNT2 = TCNT2;
-
+  // Check for stick arming: yaw held over, throttle down, for 0.5s
+  if(Armed)
+    hold = RxInYaw >= STICK_THROW && abs(RxInPitch) <= STICK_THROW;
+  else
+    hold = RxInYaw <= -STICK_THROW && abs(RxInPitch) <= STICK_THROW;
+  if(RxInCollective > 0 || !hold)
+    timersStop(TIMER_ARMING);
+  else if(!timersRunning(TIMER_ARMING))
+    timersStart(TIMER_ARMING, TIMER_MS(500), 0);
+
+  if(timersFired(TIMER_ARMING)) {
     if(Armed) {
-      if(RxInYaw < STICK_THROW || abs(RxInPitch) > STICK_THROW)
-        Change_Arming = 0;    // re-set count
-    } else {
-      if(RxInYaw > -STICK_THROW || abs(RxInPitch) > STICK_THROW)
-        Change_Arming = 0;    // re-set count
-    }
-
-    // 3Sec / 0.000128 = 23437 = 0x5B8D or
-    // 2.5Sec / 0.000128 = 19531 = 0x4C4B
-    // 0.5Sec / 0.000128 = 3906 = 0x0F42
-    if(Change_Arming > 0x0F42) {
-      Armed = !Armed;
-      if(Armed)
-        CalibrateGyros();
+      Armed = false;
+#ifdef AUTOTUNE
+      if(AutotuneActive)
+        autotuneFinish();
+#endif
+    } else if(CalibrateGyros()) {    // Not without gyro samples
+      Armed = true;
+#ifdef GYRO_MPU6050
+      attitudeReset();
+#endif
+      sticksBuildCurves();
+      tpaBuildTable();
+      loopReset();
+#ifdef CAPTURE
+#ifdef AUTOTUNE
+      if(!AutotuneActive)    // Relay state is not captured
+#endif
+        captureStart();
+#endif
     }
   }
 
   ReadGyros();
 
+#ifdef GYRO_MPU6050
+  /*
+   * A sensor that stops sending leaves its last sample in gyroADC[]:
+   * disarm, as the Rx failsafe stops the sticks. CalibrateGyros()
+   * will not arm again until samples come.
+   */
+  if(mpuStalled() && Armed)
+    Armed = false;
+  attitudeUpdate();
+#if RX_AUX_CHANNELS > 0
+  AttLevel = RxInAux[ATT_LEVEL_AUX] > 0;
+#endif
+#endif
+
   LED = Armed;
 
   gyroADC[ROLL]-= gyroZero[ROLL];
   gyroADC[PITCH]-= gyroZero[PITCH];
   gyroADC[YAW]-= gyroZero[YAW];
 
-  //--- Start mixing by setting collective to motor outputs
-
-  RxInCollective = (RxInCollective * 10) >> 3;  // 0-800 -> 0-1000
-
-#ifndef SINGLE_COPTER
-  if(RxInCollective > MAX_COLLECTIVE)
-    RxInCollective = MAX_COLLECTIVE;
-#endif
-
-#ifdef SINGLE_COPTER
-  MotorOut1 = RxInCollective;
-  MotorOut2 = 840;  // 840
-  MotorOut3 = 840;  // 840
-  MotorOut4 = 945;  // 840 + 840/8
-  MotorOut5 = 945;  // 840 + 840/8
-#elif defined(DUAL_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = 500;
-  MotorOut4 = 500;
-#elif defined(TWIN_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = 500;
-  MotorOut4 = 500;
-  MotorOut5 = 500;  // Optional
-  MotorOut6 = 500;  // Optional
-#elif defined(TRI_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = RxInCollective;
-  MotorOut4 = 500;
-#elif defined(QUAD_COPTER) || defined(QUAD_X_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = RxInCollective;
-  MotorOut4 = RxInCollective;
-#elif defined(Y4_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = RxInCollective * 3 / 4;    // 25% Down
-  MotorOut4 = RxInCollective * 3 / 4;    // 25% Down
-#elif defined(HEX_COPTER) ||  defined(Y6_COPTER)
-  MotorOut1 = RxInCollective;
-  MotorOut2 = RxInCollective;
-  MotorOut3 = RxInCollective;
-  MotorOut4 = RxInCollective;
-  MotorOut5 = RxInCollective;
-  MotorOut6 = RxInCollective;
-#endif
-
-  imax = RxInCollective;
-  if(imax < 0)
-    imax = 0;
-  imax>>= 3;  /* 1000 -> 200 */
-
-  /* Calculate roll output - Test without props!! */
-
-  RxInRoll = ((int32_t)RxInRoll * (uint32_t)GainInADC[ROLL]) >> STICK_GAIN_SHIFT;
-  gyroADC[ROLL] = ((int32_t)gyroADC[ROLL] * (uint32_t)GainInADC[ROLL]) >> GYRO_GAIN_SHIFT;
-  if(Config.RollGyroDirection == GYRO_NORMAL)
-    gyroADC[ROLL] = -gyroADC[ROLL];
-
-  if(Armed) {
-    if(0) {
-      error = RxInRoll - gyroADC[ROLL];
-      if(error > emax)
-        error = emax;
-      else if(error < -emax)
-        error = -emax;
-      integral[ROLL]+= error;
-      if(integral[ROLL] > imax)
-        integral[ROLL] = imax;
-      else if(integral[ROLL] < -imax)
-        integral[ROLL] = -imax;
-      derivative = error - last_error[ROLL];
-      last_error[ROLL] = error;
-      RxInRoll+= error + (integral[ROLL] >> 2) + (derivative >> 2);
-    } else {
-      RxInRoll-= gyroADC[ROLL];
-    }
-  }
-
-#ifdef SINGLE_COPTER
-  MotorOut2+= RxInRoll;
-  MotorOut4-= RxInRoll;
-#elif defined(DUAL_COPTER)
-  MotorOut4+= RxInRoll;
-#elif defined(TWIN_COPTER)
-  RxInRoll = (RxInRoll * 7) >> 3;  // Approximation of sin(60) without div
-  MotorOut1+= RxInRoll;
-  MotorOut2-= RxInRoll;
-#elif defined(TRI_COPTER)
-  RxInRoll = (RxInRoll * 7) >> 3;  // (.875 versus .86602540)
-  MotorOut1+= RxInRoll;
-  MotorOut2-= RxInRoll;
-#elif defined(QUAD_COPTER)
-  MotorOut2+= RxInRoll;
-  MotorOut3-= RxInRoll;
-#elif defined(QUAD_X_COPTER)
-  RxInRoll = RxInRoll >> 1;
-  MotorOut1+= RxInRoll;
-  MotorOut2-= RxInRoll;
-  MotorOut3-= RxInRoll;
-  MotorOut4+= RxInRoll;
-#elif defined(Y4_COPTER)
-  RxInRoll = (RxInRoll * 7) >> 3;
-  MotorOut1+= RxInRoll;
-  MotorOut2-= RxInRoll;
-#elif defined(HEX_COPTER)
-  RxInRoll = (RxInRoll * 7) >> 3;
-  MotorOut2-= RxInRoll;
-  MotorOut3-= RxInRoll;
-  MotorOut5+= RxInRoll;
-  MotorOut6+= RxInRoll;
-#elif defined(Y6_COPTER)
-  RxInRoll = (RxInRoll * 7) >> 3;
-  MotorOut1+= RxInRoll;
-  MotorOut2+= RxInRoll;
-  MotorOut3-= RxInRoll;
-  MotorOut4-= RxInRoll;
+#ifdef SPECTRUM
+  if(SpectrumEnabled)
+    spectrumSample();
 #endif
+}
 
-  /* Calculate pitch output - Test without props!! */
-
-  RxInPitch = ((int32_t)RxInPitch * (uint32_t)GainInADC[PITCH]) >> STICK_GAIN_SHIFT;
-  gyroADC[PITCH] = ((int32_t)gyroADC[PITCH] * (uint32_t)GainInADC[PITCH]) >> GYRO_GAIN_SHIFT;
-  if(Config.PitchGyroDirection == GYRO_NORMAL)
-    gyroADC[PITCH] = -gyroADC[PITCH];
-
-  if(Armed) {
-    if(0) {
-      error = RxInPitch - gyroADC[PITCH];
-      if(error > emax)
-        error = emax;
-      else if(error < -emax)
-        error = -emax;
-      integral[PITCH]+= error;
-      if(integral[PITCH] > imax)
-        integral[PITCH] = imax;
-      else if(integral[PITCH] < -imax)
-        integral[PITCH] = -imax;
-      derivative = error - last_error[PITCH];
-      last_error[PITCH] = error;
-      RxInPitch+= error + (integral[PITCH] >> 2) + (derivative >> 2);
-    } else {
-      RxInPitch-= gyroADC[PITCH];
-    }
-  }
-
-#ifdef SINGLE_COPTER
-  MotorOut3+= RxInPitch;
-  MotorOut5-= RxInPitch;
-#elif defined(DUAL_COPTER)
-  MotorOut3+= RxInPitch;
-#elif defined(TWIN_COPTER)
-  MotorOut3-= SERVO_REVERSE RxInPitch;
-  MotorOut4+= SERVO_REVERSE RxInPitch;
-  // Stick Only, Optional
-  RxInOrgPitch = abs(RxInOrgPitch);
-  MotorOut5+= RxInOrgPitch;      // Tain Servo-Optional, Down Only
-  MotorOut6-= RxInOrgPitch;      // Tain Servo-Optional, Down Only (Reverse)
-#elif defined(TRI_COPTER)
-  MotorOut3-= RxInPitch;
-  RxInPitch = (RxInPitch >> 1);      // cosine of 60
-  MotorOut1+= RxInPitch;
-  MotorOut2+= RxInPitch;
-#elif defined(QUAD_COPTER)
-  MotorOut1+= RxInPitch;
-  MotorOut4-= RxInPitch;
-#elif defined(QUAD_X_COPTER)
-  RxInPitch = (RxInPitch >> 1);      // cosine of 60
-  MotorOut1+= RxInPitch;
-  MotorOut2+= RxInPitch;
-  MotorOut3-= RxInPitch;
-  MotorOut4-= RxInPitch;
-#elif defined(Y4_COPTER)
-  MotorOut1+= RxInPitch;
-  MotorOut2+= RxInPitch;
-  MotorOut3-= RxInPitch;
-  MotorOut4-= RxInPitch;
-#elif defined(HEX_COPTER)
-  MotorOut1+= RxInPitch;
-  MotorOut4-= RxInPitch;
-  RxInPitch = (RxInPitch >> 2);
-  MotorOut2+= RxInPitch;
-  MotorOut3-= RxInPitch;
-  MotorOut5-= RxInPitch;
-  MotorOut6+= RxInPitch;
-#elif defined(Y6_COPTER)
-  MotorOut5-= RxInPitch;
-  MotorOut6-= RxInPitch;
-  RxInPitch = (RxInPitch >> 1);      // cosine of 60
-  MotorOut1+= RxInPitch;
-  MotorOut2+= RxInPitch;
-  MotorOut3+= RxInPitch;
-  MotorOut4+= RxInPitch;
+static inline void loop()
+{
+  loopInputs();
+#ifdef CAPTURE
+  captureFrame(Armed);
 #endif
+  loopCompute();
 
-  /* Calculate yaw output - Test without props!! */
-
-  RxInYaw = ((int32_t)RxInYaw * (uint32_t)GainInADC[YAW]) >> STICK_GAIN_SHIFT;
-  gyroADC[YAW] = ((int32_t)gyroADC[YAW] * (uint32_t)GainInADC[YAW]) >> GYRO_GAIN_SHIFT;
-  if(Config.YawGyroDirection == GYRO_NORMAL)
-    gyroADC[YAW] = -gyroADC[YAW];
-
-  if(Armed) {
-    error = RxInYaw - gyroADC[YAW];
-    if(error > emax)
-      error = emax;
-    else if(error < -emax)
-      error = -emax;
-    integral[YAW]+= error;
-    if(integral[YAW] > imax)
-      integral[YAW] = imax;
-    else if(integral[YAW] < -imax)
-      integral[YAW] = -imax;
-    derivative = error - last_error[YAW];
-    last_error[YAW] = error;
-    RxInYaw+= error + (integral[YAW] >> 4) + (derivative >> 4);
-  }
-
-#ifdef SINGLE_COPTER
-  MotorOut2+= RxInYaw;
-  MotorOut3+= RxInYaw;
-  MotorOut4+= RxInYaw;
-  MotorOut5+= RxInYaw;
-#elif defined(DUAL_COPTER)
-  MotorOut1-= RxInYaw;
-  MotorOut2+= RxInYaw;
-#elif defined(TWIN_COPTER)
-  MotorOut3+= SERVO_REVERSE(RxInYaw >> 1);
-  MotorOut4+= SERVO_REVERSE(RxInYaw >> 1);
-#elif defined(TRI_COPTER)
-  MotorOut4+= SERVO_REVERSE RxInYaw;
-#elif defined(QUAD_COPTER)
-  MotorOut1-= RxInYaw;
-  MotorOut2+= RxInYaw;
-  MotorOut3+= RxInYaw;
-  MotorOut4-= RxInYaw;
-#elif defined(QUAD_X_COPTER)
-  MotorOut1-= RxInYaw;
-  MotorOut2+= RxInYaw;
-  MotorOut3-= RxInYaw;
-  MotorOut4+= RxInYaw;
-#elif defined(Y4_COPTER)
-  if((MotorOut3 - RxInYaw) < 100)
-    RxInYaw = MotorOut3 - 100;  // Yaw Range Limit
-  if((MotorOut3 - RxInYaw) > 1000)
-    RxInYaw = MotorOut3 - 1000;  // Yaw Range Limit
-
-  if((MotorOut4 + RxInYaw) < 100)
-    RxInYaw = 100 - MotorOut4;  // Yaw Range Limit
-  if((MotorOut4 + RxInYaw) > 1000)
-    RxInYaw = 1000 - MotorOut4;  // Yaw Range Limit
-
-  MotorOut3-= RxInYaw;
-  MotorOut4+= RxInYaw;
-#elif defined(HEX_COPTER)
-  MotorOut1-= RxInYaw;
-  MotorOut2+= RxInYaw;
-  MotorOut3-= RxInYaw;
-  MotorOut4+= RxInYaw;
-  MotorOut5-= RxInYaw;
-  MotorOut6+= RxInYaw;
-#elif defined(Y6_COPTER)
-  MotorOut1-= RxInYaw;
-  MotorOut4-= RxInYaw;
-  MotorOut5-= RxInYaw;
-  MotorOut2+= RxInYaw;
-  MotorOut3+= RxInYaw;
-  MotorOut6+= RxInYaw;
+  LED = 0;
+  output_motor_ppm();
+#ifdef TELEMETRY
+  if(timersFired(TIMER_TELEMETRY)) {
+    motorsDeadlineSend();
+#ifdef LATENCY_TRACE
+    latencySend();
 #endif
-
-#if defined(TRI_COPTER)
-  /*
-   * Rather than clipping the motor outputs and causing instability
-   * at throttle saturation, we pull down the throttle of the other
-   * motors. This gives priority to stabilization without a fixed
-   * collective limit.
-   */
-  imax = MotorOut1;
-  if(MotorOut2 > imax)
-    imax = MotorOut2;
-  if(MotorOut3 > imax)
-    imax = MotorOut3;
-  imax-= 1000;
-  if(imax > 0) {
-    MotorOut1-= imax;
-    MotorOut2-= imax;
-    MotorOut3-= imax;
   }
 #endif
-
-  imax = 114;
-  //--- Limit the lowest value to avoid stopping of motor if motor value is under-saturated ---
-  if(MotorOut1 < imax)
-    MotorOut1 = imax;  // this is the motor idle level
-  if(MotorOut2 < imax)
-    MotorOut2 = imax;
-#if defined(TRI_COPTER) || defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER)
-  if(MotorOut3 < imax)
-    MotorOut3 = imax;
-#endif
-#if defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER)
-  if(MotorOut4 < imax)
-    MotorOut4 = imax;
-#endif
-#if defined(HEX_COPTER) || defined(Y6_COPTER)
-  if(MotorOut5 < imax)
-    MotorOut5 = imax;
-  if(MotorOut6 < imax)
-    MotorOut6 = imax;
-#endif
-
-  //--- Output to motor ESC's ---
-  if(RxInCollective < 1 || !Armed) {
-    /* turn off motors unless armed and collective is non-zero */
-#ifdef SINGLE_COPTER
-    MotorOut1 = 0;
-    MotorOut2 = 840;
-    MotorOut3 = 840;
-    MotorOut4 = 840;
-    MotorOut5 = 840;
-#elif defined(DUAL_COPTER)
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    if(!Armed) {
-      MotorOut3 = 500;
-      MotorOut4 = 500;
-    }
-#elif defined(TWIN_COPTER)
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    if(!Armed) {
-      MotorOut3 = 500;
-      MotorOut4 = 500;
-      MotorOut5 = 500;
-      MotorOut6 = 500;
-    }
-#elif defined(TRI_COPTER)
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    MotorOut3 = 0;
-    if(!Armed)
-      MotorOut4 = 500;
-#elif defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER)
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    MotorOut3 = 0;
-    MotorOut4 = 0;
-#elif defined(HEX_COPTER) ||  defined(Y6_COPTER)
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    MotorOut3 = 0;
-    MotorOut4 = 0;
-    MotorOut5 = 0;
-    MotorOut6 = 0;
-#endif
-  }
-
-  LED = 0;
-  output_motor_ppm();
 }
 
 int main()
@@ -0,0 +1,162 @@
+#include "latency.h"
+
+#ifdef LATENCY_TRACE
+
+/*** BEGIN VARIABLES ***/
+static struct latencyTag latencyTag[LATENCY_CHANNELS];
+static struct latencyPair latencyPair[LATENCY_CHANNELS][MOTOR_OUTPUTS];
+static uint16_t latencyStart;        // Current frame start, timer1 ticks
+static uint32_t latencyBase;         // The same, extended to 32 bits
+#ifdef TELEMETRY
+static uint8_t latencyNext;          // Next pair to send
+#endif
+/*** END VARIABLES ***/
+
+/*
+ * Tag a channel with the time its new value was captured. Called
+ * from RxGetChannels(), within a frame of the capture, so the time
+ * is close to the frame start; not after an overrun (see
+ * MotorDeadline), when the capture may be any age.
+ */
+void latencyCapture(uint8_t channel, uint16_t time)
+{
+  struct latencyTag *t = &latencyTag[channel];
+
+  if(MotorDeadline.missed)
+    return;
+  t->time = latencyBase + (int16_t)(time - latencyStart);
+  t->fresh = true;
+}
+
+/*
+ * The mix has been made: fresh tags move on to the outputs their
+ * channel feeds (a bit mask per channel, see mixerSetup()).
+ */
+void latencyMix(const uint8_t *feeds)
+{
+  for(uint8_t i = 0;i < LATENCY_CHANNELS;i++) {
+    struct latencyTag *t = &latencyTag[i];
+
+    if(t->fresh) {
+      t->pending = feeds[i];
+      t->fresh = false;
+    }
+  }
+}
+
+/*
+ * These outputs were stopped after the mix; they carry no stick.
+ */
+void latencyStop(uint8_t outputs)
+{
+  for(uint8_t i = 0;i < LATENCY_CHANNELS;i++)
+    latencyTag[i].pending&= ~outputs;
+}
+
+static void latencyRecord(struct latencyPair *p, uint32_t ticks)
+{
+  uint16_t us = ticks > 0xffffUL << 3 ? 0xffff : ticks >> 3;
+  uint8_t b = us >> LATENCY_BUCKET_SHIFT;
+
+  if(b >= LATENCY_BUCKETS)
+    b = LATENCY_BUCKETS - 1;
+  if(p->bucket[b] == 0xff) {
+    for(uint8_t i = 0;i < LATENCY_BUCKETS;i++)
+      p->bucket[i]>>= 1;
+  }
+  p->bucket[b]++;
+  if(!p->max || us < p->min)
+    p->min = us;
+  if(us > p->max)
+    p->max = us;
+}
+
+/*
+ * End of output_motor_ppm(). `outputs` pulsed in the frame just set
+ * up, falling at MotorStartTCNT1 + MotorOut[] as it was on entry;
+ * deliver the tags pending on them, then move on to the next frame.
+ * An overrun frame's edges were not made in time: its tags are
+ * dropped.
+ */
+void latencyPulse(uint8_t outputs)
+{
+  for(uint8_t i = 0;i < LATENCY_CHANNELS;i++) {
+    struct latencyTag *t = &latencyTag[i];
+    uint8_t due = t->pending & outputs;
+
+    if(MotorDeadline.missed) {
+      t->pending = 0;
+      continue;
+    }
+    t->pending&= ~due;
+    for(uint8_t o = 0;o < MOTOR_OUTPUTS;o++) {
+      if(due & _BV(o))
+        latencyRecord(&latencyPair[i][o], latencyBase + (uint16_t)MotorOut[o] - t->time);
+    }
+  }
+
+  latencyBase+= (uint16_t)(MotorStartTCNT1 - latencyStart);
+  latencyStart = MotorStartTCNT1;
+}
+
+/*
+ * Summarize a pair; false if it has no samples. Percentiles are the
+ * upper edge of their bucket, within min and max.
+ */
+bool latencyStats(uint8_t channel, uint8_t output, struct latencyStats *s)
+{
+  const struct latencyPair *p = &latencyPair[channel][output];
+  uint16_t total = 0, sum = 0;
+  uint8_t i;
+
+  for(i = 0;i < LATENCY_BUCKETS;i++)
+    total+= p->bucket[i];
+  if(!total)
+    return false;
+
+  s->channel = channel;
+  s->output = output;
+  s->samples = total;
+  s->min = p->min;
+  s->max = p->max;
+  s->p50 = s->p99 = p->max;
+  for(i = 0;i < LATENCY_BUCKETS - 1;i++) {
+    uint16_t edge = (uint16_t)(i + 1) << LATENCY_BUCKET_SHIFT;
+
+    sum+= p->bucket[i];
+    if(edge > p->max)
+      break;
+    if(edge < p->min)
+      continue;
+    if(s->p99 == p->max && (uint32_t)sum * 100 >= (uint32_t)total * 99)
+      s->p99 = edge;
+    if(s->p50 == p->max && sum * 2 >= total)
+      s->p50 = edge;
+  }
+  return true;
+}
+
+#ifdef TELEMETRY
+/*
+ * Send the next LATENCY_SEND_PAIRS pairs that have samples, as
+ * TELEMETRY_LATENCY records. Called once a second.
+ */
+void latencySend()
+{
+  struct latencyStats s;
+  uint8_t sent = 0;
+
+  for(uint8_t n = 0;n < LATENCY_CHANNELS * MOTOR_OUTPUTS && sent < LATENCY_SEND_PAIRS;n++) {
+    uint8_t pair = latencyNext;
+
+    if(++latencyNext >= LATENCY_CHANNELS * MOTOR_OUTPUTS)
+      latencyNext = 0;
+    if(!latencyStats(pair / MOTOR_OUTPUTS, pair % MOTOR_OUTPUTS, &s))
+      continue;
+    if(!telemetrySend(TELEMETRY_LATENCY, &s, sizeof(s)))
+      break;
+    sent++;
+  }
+}
+#endif
+#endif
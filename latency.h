@@ -0,0 +1,71 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "config.h"
+#include "motors.h"
+#include "telemetry.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Stick-to-pulse latency tracer. Each Rx capture is tagged with the
+ * timer1 time it completed (the falling edge of a PWM pulse, the last
+ * byte of a serial frame). RxGetChannels() takes the tag along with
+ * the value, mixerMix() passes it to the outputs that channel feeds
+ * (mixerStop() drops it from stopped ones), and output_motor_ppm()
+ * delivers it at the first pulse carrying the mix: the latency is
+ * that pulse's falling edge, where its width is set, less the tag.
+ * A newer capture replaces a tag not yet delivered.
+ *
+ * Latency is kept as a histogram per channel (roll, pitch,
+ * collective, yaw) and output, as in latencyStats(); with TELEMETRY
+ * a few pairs are sent every second as TELEMETRY_LATENCY records.
+ * Only the first change of a smoothed setpoint is timed (see
+ * rxSmooth()). Costs about 700 bytes of RAM.
+ */
+//#define LATENCY_TRACE
+
+#if defined(LATENCY_TRACE) && defined(MINIMAL)
+#error "LATENCY_TRACE does not fit the MINIMAL build"
+#endif
+
+#define LATENCY_CHANNELS 4           // Mixer inputs
+#define LATENCY_BUCKET_SHIFT 8       // 256us per histogram bucket
+#define LATENCY_BUCKETS 16           // The last one takes everything longer
+#define LATENCY_SEND_PAIRS 4         // Records per telemetry second
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+struct latencyTag {
+  uint32_t time;                     // Capture, timer1 ticks (extended)
+  bool fresh;                        // Not yet mixed
+  uint8_t pending;                   // Outputs mixed but not yet pulsed
+};
+
+/*
+ * Bucket counts are halved whenever one would overflow, so the
+ * histogram follows the recent flight rather than the whole one.
+ */
+struct latencyPair {
+  uint16_t min, max;                 // us
+  uint8_t bucket[LATENCY_BUCKETS];
+};
+
+// Also the TELEMETRY_LATENCY payload
+struct latencyStats {
+  uint8_t channel;
+  uint8_t output;
+  uint16_t samples;                  // In the (decayed) histogram
+  uint16_t min, p50, p99, max;       // us; percentiles per bucket
+};
+/*** END TYPES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void latencyCapture(uint8_t channel, uint16_t time);
+void latencyMix(const uint8_t *feeds);
+void latencyStop(uint8_t outputs);
+void latencyPulse(uint8_t outputs);
+bool latencyStats(uint8_t channel, uint8_t output, struct latencyStats *s);
+void latencySend(void);
+/*** END PROTOTYPES ***/
+
+#endif
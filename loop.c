@@ -0,0 +1,136 @@
+#include "loop.h"
+
+#include "autotune.h"
+#include "gyros.h"
+#include "mixer.h"
+#include "notch.h"
+#include "receiver.h"
+#include "settings.h"
+#include "stabilizer.h"
+#include "sticks.h"
+#include "tpa.h"
+#ifdef GYRO_MPU6050
+#include "attitude.h"
+#endif
+
+/*** BEGIN VARIABLES ***/
+bool Armed;
+/*** END VARIABLES ***/
+
+/*
+ * Forget the controller state of the last flight, so each flight
+ * starts from the same state (and a capture can be replayed).
+ */
+void loopReset()
+{
+  stabilizerReset();
+  mixerReset();
+#ifdef GYRO_NOTCH
+  notchReset();
+#endif
+}
+
+/*
+ * Compute stage: filters, stabilization and mixing, from the inputs
+ * left by loopInputs() (and Config, GainInADC[], GainPotADC[] and the
+ * tables built from them) to MotorOut[]. No hardware access, so the
+ * same code can be run over a capture (see capture.h), as the host
+ * replay test does (test/replay_test.c).
+ */
+void loopCompute()
+{
+  int16_t imax;
+  uint8_t tpa;
+  struct mixerInput in;
+
+#ifdef GYRO_NOTCH
+  notchUpdate(RxInCollective);
+  gyroADC[ROLL] = notchApply(ROLL, gyroADC[ROLL]);
+  gyroADC[PITCH] = notchApply(PITCH, gyroADC[PITCH]);
+  gyroADC[YAW] = notchApply(YAW, gyroADC[YAW]);
+#endif
+
+#ifdef AUTOTUNE
+  if(AutotuneActive && Armed)
+    autotuneStep();
+#endif
+
+  if(RxInCollective > MAX_COLLECTIVE)
+    RxInCollective = MAX_COLLECTIVE;
+
+  /* Gyro gains are scheduled against collective */
+  tpa = tpaIndex(RxInCollective);
+
+  imax = RxInCollective;
+  if(imax < 0)
+    imax = 0;
+  imax>>= 3;  /* 1000 -> 200 */
+
+  /* Calculate roll output - Test without props!! */
+
+#ifdef GYRO_MPU6050
+  if(AttLevel)
+    RxInRoll = attitudeLevel(ROLL, RxInRoll, TpaGyroGain[ROLL][tpa]);
+  else
+#endif
+  RxInRoll = sticksApply(ROLL, RxInRoll);
+  gyroADC[ROLL] = ((int32_t)gyroADC[ROLL] * (uint32_t)TpaGyroGain[ROLL][tpa]) >> GYRO_GAIN_SHIFT;
+  if(Config.RollGyroDirection == GYRO_NORMAL)
+    gyroADC[ROLL] = -gyroADC[ROLL];
+
+  if(Armed)
+    RxInRoll = stabilizerApply(ROLL, RxInRoll, gyroADC[ROLL], imax);
+
+#ifdef AUTOTUNE
+  if(AutotuneAxis == ROLL)
+    RxInRoll = AutotuneOutput;
+#endif
+
+  /* Calculate pitch output - Test without props!! */
+
+#ifdef GYRO_MPU6050
+  if(AttLevel)
+    RxInPitch = attitudeLevel(PITCH, RxInPitch, TpaGyroGain[PITCH][tpa]);
+  else
+#endif
+  RxInPitch = sticksApply(PITCH, RxInPitch);
+  gyroADC[PITCH] = ((int32_t)gyroADC[PITCH] * (uint32_t)TpaGyroGain[PITCH][tpa]) >> GYRO_GAIN_SHIFT;
+  if(Config.PitchGyroDirection == GYRO_NORMAL)
+    gyroADC[PITCH] = -gyroADC[PITCH];
+
+  if(Armed)
+    RxInPitch = stabilizerApply(PITCH, RxInPitch, gyroADC[PITCH], imax);
+
+#ifdef AUTOTUNE
+  if(AutotuneAxis == PITCH)
+    RxInPitch = AutotuneOutput;
+#endif
+
+  /* Calculate yaw output - Test without props!! */
+
+  RxInYaw = sticksApply(YAW, RxInYaw);
+  gyroADC[YAW] = ((int32_t)gyroADC[YAW] * (uint32_t)TpaGyroGain[YAW][tpa]) >> GYRO_GAIN_SHIFT;
+  if(Config.YawGyroDirection == GYRO_NORMAL)
+    gyroADC[YAW] = -gyroADC[YAW];
+
+  if(Armed)
+    RxInYaw = stabilizerApply(YAW, RxInYaw, gyroADC[YAW], imax);
+
+#ifdef AUTOTUNE
+  if(AutotuneAxis == YAW)
+    RxInYaw = AutotuneOutput;
+#endif
+
+  //--- Mix into the outputs of the selected frame ---
+  in.collective = RxInCollective;
+  in.roll = RxInRoll;
+  in.pitch = RxInPitch;
+  in.yaw = RxInYaw;
+  mixerMix(&in);
+
+  //--- Output to motor ESC's ---
+  if(RxInCollective < 1 || !Armed) {
+    /* turn off motors unless armed and collective is non-zero */
+    mixerStop(Armed);
+  }
+}
@@ -0,0 +1,15 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "config.h"
+
+/*** BEGIN VARIABLES ***/
+extern bool Armed;
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void loopReset(void);
+void loopCompute(void);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -0,0 +1,410 @@
+#include "mixer.h"
+
+#include <avr/pgmspace.h>
+#include "gyros.h"
+#include "latency.h"
+#include "motors.h"
+#include "receiver.h"
+#include "settings.h"
+#include "trig.h"
+
+/*** BEGIN VARIABLES ***/
+struct mixerFrame Mixer;
+
+uint8_t MixerSaturated;
+
+#if defined(MIXER_ALL_FRAMES) || defined(TRI_COPTER)
+static int16_t mixerTriServo;        // Estimated tail deflection, Q4
+#if TRI_SERVO_DEG > 0
+static int16_t mixerTriBoost[TRI_BOOST_POINTS];  // 1 / cos(tilt), Q14
+#endif
+#endif
+static uint8_t mixerSatHigh[MIXER_OUTPUTS];  // Blocked when output is at max
+static uint8_t mixerSatLow[MIXER_OUTPUTS];   // Blocked when output is at min
+#ifdef LATENCY_TRACE
+static uint8_t mixerFeeds[LATENCY_CHANNELS];  // Outputs fed, per Rx channel
+#endif
+/*** END VARIABLES ***/
+
+/*** BEGIN POST-MIX HOOKS ***/
+#if defined(MIXER_ALL_FRAMES) || \
+    !(defined(TWIN_COPTER) || defined(TRI_COPTER) || defined(Y4_COPTER))
+static void mixerPostNone(const struct mixerInput *in)
+{
+}
+#endif
+
+#if defined(MIXER_ALL_FRAMES) || defined(TWIN_COPTER)
+/*
+ * Optional tail servos on M5/M6 follow the pitch stick, down only.
+ */
+static void mixerPostTwin(const struct mixerInput *in)
+{
+  int16_t pitch = abs(RxInOrgPitch);
+
+  MotorOut[4]+= pitch;
+  MotorOut[5]-= pitch;
+}
+#endif
+
+#if defined(MIXER_ALL_FRAMES) || defined(TRI_COPTER)
+/*
+ * Tail servo lead and tilt boost (see TRI_SERVO_MS), then rather
+ * than clipping the motor outputs and causing instability at
+ * throttle saturation, we pull down the throttle of the other
+ * motors. This gives priority to stabilization without a fixed
+ * collective limit.
+ */
+static void mixerPostTri(const struct mixerInput *in)
+{
+  int16_t tail = MotorOut[3] - Mixer.output[3].offset;
+  int16_t servo = mixerTriServo >> 4;
+  int16_t over;
+
+  tail+= ((int32_t)(tail - servo) * TRI_LEAD) >> 6;
+  if(tail > TRI_THROW)
+    tail = TRI_THROW;
+  else if(tail < -TRI_THROW)
+    tail = -TRI_THROW;
+  MotorOut[3] = Mixer.output[3].offset + tail;
+
+  over = (tail << 4) - mixerTriServo;
+  if(over > TRI_SLEW)
+    over = TRI_SLEW;
+  else if(over < -TRI_SLEW)
+    over = -TRI_SLEW;
+  mixerTriServo+= over;
+
+#if TRI_SERVO_DEG > 0
+  servo = abs(mixerTriServo >> 4);
+  if(servo && MotorOut[2] > 0) {
+    const int16_t *b = &mixerTriBoost[servo >> TRI_BOOST_SHIFT];
+    uint8_t f = servo & ((1 << TRI_BOOST_SHIFT) - 1);
+    int16_t boost = b[0] + (((b[1] - b[0]) * f) >> TRI_BOOST_SHIFT);
+
+    MotorOut[2] = ((int32_t)MotorOut[2] * boost) >> 14;
+  }
+#endif
+
+  over = MotorOut[0];
+
+  if(MotorOut[1] > over)
+    over = MotorOut[1];
+  if(MotorOut[2] > over)
+    over = MotorOut[2];
+  over-= 1000;
+  if(over > 0) {
+    MotorOut[0]-= over;
+    MotorOut[1]-= over;
+    MotorOut[2]-= over;
+  }
+}
+#endif
+
+#if defined(MIXER_ALL_FRAMES) || defined(Y4_COPTER)
+/*
+ * Keep the rear pair within range by limiting yaw rather than
+ * letting either motor clip.
+ */
+static void mixerPostY4(const struct mixerInput *in)
+{
+  int16_t yaw = in->yaw;
+  int16_t m3 = MotorOut[2] + yaw;    // Without yaw
+  int16_t m4 = MotorOut[3] - yaw;
+
+  if((m3 - yaw) < 100)
+    yaw = m3 - 100;  // Yaw Range Limit
+  if((m3 - yaw) > 1000)
+    yaw = m3 - 1000;  // Yaw Range Limit
+
+  if((m4 + yaw) < 100)
+    yaw = 100 - m4;  // Yaw Range Limit
+  if((m4 + yaw) > 1000)
+    yaw = 1000 - m4;  // Yaw Range Limit
+
+  MotorOut[2] = m3 - yaw;
+  MotorOut[3] = m4 + yaw;
+}
+#endif
+/*** END POST-MIX HOOKS ***/
+
+/*** BEGIN FRAME TABLES ***/
+#define MOTOR(c, r, p, y) { c, r, p, y, 0, 0, MIXER_MOTOR }
+#define SERVO(r, p, y, centre, flags) { 0, r, p, y, centre, centre, flags }
+#define UNUSED { 0, 0, 0, 0, 0, 0, 0 }
+
+/*
+ * Roll and pitch factors: 56 = 7/8 (sin 60, .875 versus .866),
+ * 32 = cos 60, 16 = 1/4, 48 = 3/4.
+ */
+static const struct mixerFrame mixerFrames[MIXER_FRAME_TABLE] PROGMEM = {
+#if defined(MIXER_ALL_FRAMES) || defined(SINGLE_COPTER)
+  [MIXER_INDEX(FRAME_SINGLE)] = { {
+    MOTOR(64, 0, 0, 0),
+    SERVO(64, 0, 64, 840, MIXER_SLOW | MIXER_WIDE),
+    SERVO(0, 64, 64, 840, MIXER_SLOW | MIXER_WIDE),
+    { 0, -64, 0, 64, 945, 840, MIXER_SLOW | MIXER_WIDE },  // 840 + 840/8
+    { 0, 0, -64, 64, 945, 840, MIXER_SLOW | MIXER_WIDE },
+    { 0, 0, 0, 0, 0, 0, MIXER_SLOW | MIXER_WIDE },
+  }, 6, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(DUAL_COPTER)
+  [MIXER_INDEX(FRAME_DUAL)] = { {
+    MOTOR(64, 0, 0, -64),
+    MOTOR(64, 0, 0, 64),
+    SERVO(0, 64, 0, 500, MIXER_SLOW | MIXER_LIVE),
+    SERVO(64, 0, 0, 500, MIXER_SLOW | MIXER_LIVE),
+  }, 4, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(TWIN_COPTER)
+  [MIXER_INDEX(FRAME_TWIN)] = { {
+    MOTOR(64, 56, 0, 0),
+    MOTOR(64, -56, 0, 0),
+    SERVO(0, -(SERVO_REVERSE 64), SERVO_REVERSE 32, 500, MIXER_SLOW | MIXER_LIVE),
+    SERVO(0, SERVO_REVERSE 64, SERVO_REVERSE 32, 500, MIXER_SLOW | MIXER_LIVE),
+    SERVO(0, 0, 0, 500, MIXER_SLOW | MIXER_LIVE),  // Optional tail
+    SERVO(0, 0, 0, 500, MIXER_SLOW | MIXER_LIVE),  // Optional tail, reverse
+  }, 6, mixerPostTwin },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(TRI_COPTER)
+  [MIXER_INDEX(FRAME_TRI)] = { {
+    MOTOR(64, 56, 32, 0),
+    MOTOR(64, -56, 32, 0),
+    MOTOR(64, 0, -64, 0),
+    SERVO(0, 0, SERVO_REVERSE 64, 500, MIXER_SLOW | MIXER_LIVE),
+  }, 4, mixerPostTri },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(QUAD_COPTER)
+  [MIXER_INDEX(FRAME_QUAD)] = { {
+    MOTOR(64, 0, 64, -64),
+    MOTOR(64, 64, 0, 64),
+    MOTOR(64, -64, 0, 64),
+    MOTOR(64, 0, -64, -64),
+  }, 4, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(QUAD_X_COPTER)
+  [MIXER_INDEX(FRAME_QUAD_X)] = { {
+    MOTOR(64, 32, 32, -64),
+    MOTOR(64, -32, 32, 64),
+    MOTOR(64, -32, -32, -64),
+    MOTOR(64, 32, -32, 64),
+  }, 4, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(Y4_COPTER)
+  [MIXER_INDEX(FRAME_Y4)] = { {
+    MOTOR(64, 56, 64, 0),
+    MOTOR(64, -56, 64, 0),
+    MOTOR(48, 0, -64, -64),          // 25% down
+    MOTOR(48, 0, -64, 64),
+  }, 4, mixerPostY4 },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(HEX_COPTER)
+  [MIXER_INDEX(FRAME_HEX)] = { {
+    MOTOR(64, 0, 64, -64),
+    MOTOR(64, -56, 16, 64),
+    MOTOR(64, -56, -16, -64),
+    MOTOR(64, 0, -64, 64),
+    MOTOR(64, 56, -16, -64),
+    MOTOR(64, 56, 16, 64),
+  }, 6, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(Y6_COPTER)
+  [MIXER_INDEX(FRAME_Y6)] = { {
+    MOTOR(64, 56, 32, -64),
+    MOTOR(64, 56, 32, 64),
+    MOTOR(64, -56, 32, 64),
+    MOTOR(64, -56, 32, -64),
+    MOTOR(64, 0, -64, -64),
+    MOTOR(64, 0, -64, 64),
+  }, 6, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(OCTO_COPTER)
+  [MIXER_INDEX(FRAME_OCTO)] = { {    // 45 = sin 45
+    MOTOR(64, 0, 64, -64),
+    MOTOR(64, -45, 45, 64),
+    MOTOR(64, -64, 0, -64),
+    MOTOR(64, -45, -45, 64),
+    MOTOR(64, 0, -64, -64),
+    MOTOR(64, 45, -45, 64),
+    MOTOR(64, 64, 0, -64),
+    MOTOR(64, 45, 45, 64),
+  }, 8, mixerPostNone },
+#endif
+#if defined(MIXER_ALL_FRAMES) || defined(X8_COPTER)
+  [MIXER_INDEX(FRAME_X8)] = { {      // Quad-X, lower props turn the other way
+    MOTOR(64, 32, 32, -64),
+    MOTOR(64, -32, 32, 64),
+    MOTOR(64, -32, -32, -64),
+    MOTOR(64, 32, -32, 64),
+    MOTOR(64, 32, 32, 64),
+    MOTOR(64, -32, 32, -64),
+    MOTOR(64, -32, -32, 64),
+    MOTOR(64, 32, -32, -64),
+  }, 8, mixerPostNone },
+#endif
+};
+/*** END FRAME TABLES ***/
+
+/*
+ * Whether a frame type exists and has pins for all its outputs.
+ */
+bool mixerFrameFits(uint8_t frame)
+{
+#ifndef MIXER_ALL_FRAMES
+  if(frame != FRAME_DEFAULT)
+    return false;
+#endif
+  return frame < FRAME_TYPES &&
+    pgm_read_byte(&mixerFrames[MIXER_INDEX(frame)].outputs) <= MOTOR_PINS;
+}
+
+/*
+ * Load the frame selected in Config into RAM. Mirrored outputs get
+ * the flags of their source so the output stage treats them alike.
+ */
+void mixerSetup()
+{
+  uint8_t frame = Config.FrameType;
+
+  if(!mixerFrameFits(frame))
+    frame = FRAME_DEFAULT;
+  memcpy_P(&Mixer, &mixerFrames[MIXER_INDEX(frame)], sizeof(Mixer));
+
+  for(uint8_t i = Mixer.outputs;i < MIXER_MIRRORED;i++)
+    Mixer.output[i] = Mixer.output[i - 2];
+
+  /*
+   * An output at its maximum blocks each axis in the direction that
+   * raises it; at its minimum, the direction that lowers it.
+   */
+  for(uint8_t i = 0;i < Mixer.outputs;i++) {
+    int8_t c[3] = { Mixer.output[i].roll, Mixer.output[i].pitch, Mixer.output[i].yaw };
+
+    mixerSatHigh[i] = 0;
+    mixerSatLow[i] = 0;
+    for(uint8_t axis = ROLL;axis <= YAW;axis++) {
+      if(c[axis] > 0) {
+        mixerSatHigh[i]|= MIXER_SAT_POS(axis);
+        mixerSatLow[i]|= MIXER_SAT_NEG(axis);
+      } else if(c[axis] < 0) {
+        mixerSatHigh[i]|= MIXER_SAT_NEG(axis);
+        mixerSatLow[i]|= MIXER_SAT_POS(axis);
+      }
+    }
+  }
+  MixerSaturated = 0;
+
+#if (defined(MIXER_ALL_FRAMES) || defined(TRI_COPTER)) && TRI_SERVO_DEG > 0
+  /*
+   * Tail motor boost for each step of servo deflection, so the post
+   * hook only interpolates: no cosine and no division per frame.
+   */
+  for(uint8_t i = 0;i < TRI_BOOST_POINTS;i++) {
+    uint16_t servo = i << TRI_BOOST_SHIFT;
+
+    mixerTriBoost[i] = (1L << 28) / trigCos(((uint32_t)servo * TRI_TILT_SCALE) >> 8);
+  }
+#endif
+
+#ifdef LATENCY_TRACE
+  /*
+   * Outputs each Rx channel reaches, mirrored ones included, in Rx
+   * channel order (roll, pitch, collective, yaw).
+   */
+  for(uint8_t i = 0;i < LATENCY_CHANNELS;i++)
+    mixerFeeds[i] = 0;
+  for(uint8_t i = 0;i < Mixer.outputs || i < MIXER_MIRRORED;i++) {
+    const struct mixerOutput *o = &Mixer.output[i];
+
+    if(o->roll)
+      mixerFeeds[0]|= _BV(i);
+    if(o->pitch)
+      mixerFeeds[1]|= _BV(i);
+    if(o->collective)
+      mixerFeeds[RX_CHANNEL_COLLECTIVE]|= _BV(i);
+    if(o->yaw)
+      mixerFeeds[3]|= _BV(i);
+  }
+#endif
+
+  motorsFrameSetup();
+}
+
+/*
+ * Mix the stabilized axes into MotorOut[]. The same code runs for
+ * every frame; only the table and the post hook differ.
+ */
+void mixerMix(const struct mixerInput *in)
+{
+  const struct mixerOutput *o = Mixer.output;
+  int32_t mix;
+  uint8_t sat;
+
+  for(uint8_t i = 0;i < Mixer.outputs;i++, o++) {
+    mix = (int32_t)in->collective * o->collective +
+      (int32_t)in->roll * o->roll +
+      (int32_t)in->pitch * o->pitch +
+      (int32_t)in->yaw * o->yaw;
+    MotorOut[i] = o->offset + (int16_t)(mix >> MIXER_SHIFT);
+  }
+
+  Mixer.post(in);
+
+  //--- Limit the lowest value to avoid stopping of motor if motor value is under-saturated ---
+  o = Mixer.output;
+  sat = 0;
+  for(uint8_t i = 0;i < Mixer.outputs;i++, o++) {
+    int16_t low = (o->flags & MIXER_MOTOR) ? MIXER_IDLE : 0;
+
+    if(MotorOut[i] <= low) {
+      MotorOut[i] = low;
+      sat|= mixerSatLow[i];
+    } else if(MotorOut[i] >= MIXER_RANGE(o->flags))
+      sat|= mixerSatHigh[i];
+  }
+  MixerSaturated = sat;
+#ifdef LATENCY_TRACE
+  latencyMix(mixerFeeds);
+#endif
+}
+
+/*
+ * Forget the mix state of the last flight. The tail servo estimate
+ * followed the mix while disarmed, but mixerStop() held the servo
+ * centred.
+ */
+void mixerReset()
+{
+  MixerSaturated = 0;
+#if defined(MIXER_ALL_FRAMES) || defined(TRI_COPTER)
+  mixerTriServo = 0;
+#endif
+}
+
+/*
+ * Turn off motors; servos centre, except live ones while armed.
+ */
+void mixerStop(bool armed)
+{
+  const struct mixerOutput *o = Mixer.output;
+#ifdef LATENCY_TRACE
+  uint8_t stopped = 0;
+#endif
+
+  for(uint8_t i = 0;i < Mixer.outputs;i++, o++) {
+    if(!armed || !(o->flags & MIXER_LIVE)) {
+      MotorOut[i] = o->stop;
+#ifdef LATENCY_TRACE
+      stopped|= _BV(i);
+#endif
+    }
+  }
+#ifdef LATENCY_TRACE
+  // Mirrored outputs follow the one two below them
+  for(uint8_t i = Mixer.outputs;i < MIXER_MIRRORED;i++) {
+    if(stopped & _BV(i - 2))
+      stopped|= _BV(i);
+  }
+  latencyStop(stopped);
+#endif
+}
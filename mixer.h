@@ -0,0 +1,142 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include "config.h"
+#include "motors.h"
+
+/*** BEGIN DEFINES ***/
+#define MIXER_OUTPUTS MOTOR_OUTPUTS
+#define MIXER_MIRRORED 6             // Outputs that may copy the one two below
+
+/*
+ * Mixer coefficients are Q6 (64 = 1.0): each output is
+ * offset + (collective * c + roll * r + pitch * p + yaw * y) >> 6.
+ */
+#define MIXER_SHIFT 6
+
+// Output flags
+#define MIXER_MOTOR _BV(0)           // ESC: idle clamp, 0 when stopped
+#define MIXER_LIVE _BV(1)            // Servo keeps mixing when armed at 0 throttle
+#define MIXER_SLOW _BV(2)            // Servo, SERVO_RATE by default
+#define MIXER_WIDE _BV(3)            // 0-2000us range (single copter servos)
+
+// Highest value of an output, and what it is added to for the pulse
+#define MIXER_RANGE(flags) (((flags) & MIXER_WIDE) ? 2000 : 1000)
+#define MIXER_BASE(flags) (((flags) & MIXER_WIDE) ? 0 : 1000)
+
+#define MIXER_IDLE 114               // Lowest running motor value
+
+/*
+ * Saturation feedback: MixerSaturated has a bit per axis and
+ * direction that some output could not follow in the last mix
+ * (pinned at its range limit, or at the idle floor for motors), so
+ * the stabilizer can stop integrating that way.
+ */
+#define MIXER_SAT_POS(axis) _BV((axis) * 2)
+#define MIXER_SAT_NEG(axis) _BV((axis) * 2 + 1)
+
+/*
+ * Tricopter tail model. The servo position is estimated by slewing
+ * towards each command at the servo's speed; the command gets a lead
+ * term (TRI_LEAD / 64 of the distance still to go) to make up for
+ * the lag, and the tail motor is boosted by 1 / cos(tilt) so its lift
+ * does not drop while it yaws. Set TRI_LEAD to 0 to disable the lead
+ * and TRI_SERVO_DEG to 0 to disable the boost.
+ */
+#define TRI_SERVO_MS 100             // Servo time from centre to full throw
+#define TRI_SERVO_DEG 40             // Tail tilt at full throw
+#define TRI_LEAD 32                  // Q6
+#define TRI_THROW 500                // Output units from centre to full
+#define TRI_SLEW ((TRI_THROW * 16L * 1000) / (TRI_SERVO_MS * ESC_RATE))  // Q4 per frame
+#define TRI_TILT_SCALE ((TRI_SERVO_DEG * 65536L * 256) / (360L * TRI_THROW))  // Q8
+
+// Boost table over servo deflection (see mixerSetup()), interpolated
+#define TRI_BOOST_SHIFT 5            // Output units per table step, bits
+#define TRI_BOOST_POINTS ((TRI_THROW >> TRI_BOOST_SHIFT) + 2)
+
+/*
+ * The frame type defined in config.h is the default; it can be
+ * changed at runtime (see motorsIdentify()) and is kept in Config.
+ * The MINIMAL build has only the default frame's table in flash.
+ */
+#ifndef MINIMAL
+#define MIXER_ALL_FRAMES
+#define MIXER_FRAME_TABLE FRAME_TYPES
+#define MIXER_INDEX(frame) (frame)
+#else
+#define MIXER_FRAME_TABLE 1
+#define MIXER_INDEX(frame) 0
+#endif
+#if defined(SINGLE_COPTER)
+#define FRAME_DEFAULT FRAME_SINGLE
+#elif defined(DUAL_COPTER)
+#define FRAME_DEFAULT FRAME_DUAL
+#elif defined(TWIN_COPTER)
+#define FRAME_DEFAULT FRAME_TWIN
+#elif defined(TRI_COPTER)
+#define FRAME_DEFAULT FRAME_TRI
+#elif defined(QUAD_COPTER)
+#define FRAME_DEFAULT FRAME_QUAD
+#elif defined(QUAD_X_COPTER)
+#define FRAME_DEFAULT FRAME_QUAD_X
+#elif defined(Y4_COPTER)
+#define FRAME_DEFAULT FRAME_Y4
+#elif defined(HEX_COPTER)
+#define FRAME_DEFAULT FRAME_HEX
+#elif defined(Y6_COPTER)
+#define FRAME_DEFAULT FRAME_Y6
+#elif defined(OCTO_COPTER)
+#define FRAME_DEFAULT FRAME_OCTO
+#elif defined(X8_COPTER)
+#define FRAME_DEFAULT FRAME_X8
+#endif
+
+#if (defined(OCTO_COPTER) || defined(X8_COPTER)) && MOTOR_PINS < 8
+#error "OCTO_COPTER and X8_COPTER need M7 and M8, which Rx aux 3-4 use"
+#endif
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+enum FrameType {
+  FRAME_SINGLE = 0, FRAME_DUAL, FRAME_TWIN, FRAME_TRI, FRAME_QUAD,
+  FRAME_QUAD_X, FRAME_Y4, FRAME_HEX, FRAME_Y6, FRAME_OCTO, FRAME_X8,
+  FRAME_TYPES
+};
+
+struct mixerOutput {
+  int8_t collective, roll, pitch, yaw;  // Q6
+  int16_t offset;                    // Added to the mix (servo centre)
+  int16_t stop;                      // Value when stopped
+  uint8_t flags;
+};
+
+struct mixerInput {
+  int16_t collective, roll, pitch, yaw;
+};
+
+/*
+ * Outputs beyond `outputs`, up to MIXER_MIRRORED, copy the output two
+ * below them (M3, M4 to M5, M6), for hardware PPM on 4-output frames. The post hook runs
+ * after the table mix, before the idle clamp.
+ */
+struct mixerFrame {
+  struct mixerOutput output[MIXER_OUTPUTS];
+  uint8_t outputs;
+  void (*post)(const struct mixerInput *in);
+};
+/*** END TYPES ***/
+
+/*** BEGIN VARIABLES ***/
+extern struct mixerFrame Mixer;      // Active frame, copied from flash
+extern uint8_t MixerSaturated;       // MIXER_SAT_* of the last mix
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void mixerSetup(void);
+bool mixerFrameFits(uint8_t frame);
+void mixerMix(const struct mixerInput *in);
+void mixerReset(void);
+void mixerStop(bool armed);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -1,19 +1,55 @@
 #include "motors.h"
 
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include "latency.h"
+#include "mixer.h"
 #include "receiver.h"
+#include "settings.h"
+#include "spectrum.h"
+#include "telemetry.h"
+#include "timers.h"
 
-int16_t MotorOut1;
-int16_t MotorOut2;
-int16_t MotorOut3;
-int16_t MotorOut4;
-int16_t MotorOut5;
-int16_t MotorOut6;
+int16_t MotorOut[MOTOR_OUTPUTS];
 int16_t MotorStartTCNT1;
-#if defined(SINGLE_COPTER) || defined(DUAL_COPTER) || defined(TWIN_COPTER) || defined(TRI_COPTER)
-uint8_t servo_skip;
-uint16_t servo_skip_divider;
+struct motorOutput MotorOutput[MOTOR_OUTPUTS];
+uint16_t MotorSoftLateMax;
+struct motorDeadline MotorDeadline;
+
+static const struct motorPin motorsPin[MOTOR_OUTPUTS] PROGMEM = {
+  { MOTOR_PORTB, _BV(2), MOTOR_OC1B },    // M1
+  { MOTOR_PORTB, _BV(1), MOTOR_OC1A },    // M2
+  { MOTOR_PORTB, _BV(0), MOTOR_SOFT },    // M3
+  { MOTOR_PORTD, _BV(7), MOTOR_SOFT },    // M4
+  { MOTOR_PORTD, _BV(6), MOTOR_OC0A },    // M5
+  { MOTOR_PORTD, _BV(5), MOTOR_OC0B },    // M6
+#if MOTOR_OUTPUTS > 6
+  { MOTOR_PORTB, _BV(3), MOTOR_SOFT },    // M7
+  { MOTOR_PORTB, _BV(4), MOTOR_SOFT },    // M8
+#endif
+};
+
+/*
+ * Output schedule for the active frame, built by motorsFrameSetup():
+ * what turns the pins on in each frame of the schedule.
+ */
+static uint8_t motorsTCCR1A[MOTOR_SLOTS];  // M1 (OC1B), M2 (OC1A)
+static uint8_t motorsTCCR0A[MOTOR_SLOTS];  // M5 (OC0A), M6 (OC0B)
+static uint8_t motorsSoftB[MOTOR_SLOTS];   // Software pins, per port
+static uint8_t motorsSoftD[MOTOR_SLOTS];
+static uint8_t motorsSlots;          // Schedule length
+static uint8_t motorsSlot;           // Next frame in the schedule
+#ifdef LATENCY_TRACE
+static uint8_t motorsOutputs[MOTOR_SLOTS];  // Outputs pulsing, bit per output
+static uint8_t motorsPulsing;        // The same, for the pulse now on
 #endif
 
+// Driven software outputs
+static uint8_t motorsSoft[MOTOR_SOFT_PINS];
+static uint8_t motorsSoftPort[MOTOR_SOFT_PINS];
+static uint8_t motorsSoftMask[MOTOR_SOFT_PINS];
+static uint8_t motorsSoftCount;
+
 void motorsSetup()
 {
   M1_DIR    = OUTPUT;
@@ -22,6 +58,10 @@ void motorsSetup()
   M4_DIR    = OUTPUT;
   M5_DIR    = OUTPUT;
   M6_DIR    = OUTPUT;
+#if MOTOR_PINS > 6
+  M7_DIR    = OUTPUT;
+  M8_DIR    = OUTPUT;
+#endif
   
   /*
    * timer0 (8bit) - run at 8MHz, used to control ESC pulses
@@ -29,16 +69,202 @@ void motorsSetup()
    */
   TCCR0B = _BV(CS00);  /* NOTE: Specified again below with FOC0x bits */
 
-#if defined(SINGLE_COPTER) || defined(DUAL_COPTER) || defined(TWIN_COPTER) || defined(TRI_COPTER)
   /*
-   * Calculate the servo rate divider (pulse loop skip count
-   * needed to avoid burning analog servos)
+   * timer2 (8bit) - run at 8MHz / 8 = 1MHz, wakes the output stage
+   * (see motorsSleep())
    */
-  for(servo_skip_divider = 1;;servo_skip_divider++)
-    if(servo_skip_divider * SERVO_RATE >= ESC_RATE)
+  TCCR2B = _BV(CS21);
+  set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+/*
+ * Only here to wake the CPU; motorsSleep() turns it on and off.
+ */
+EMPTY_INTERRUPT(TIMER2_COMPA_vect)
+
+/*
+ * Sleep for up to `wait` timer1 ticks, less MOTOR_WAKE_EARLY, or
+ * until any interrupt. Returns at once when the wait is too short
+ * to be worth it, so the caller polls the rest. The compare flag is
+ * checked with interrupts off right before sleeping: if the match
+ * has already happened, the pending interrupt ends the sleep at once
+ * instead of a full timer2 wrap later.
+ */
+static void motorsSleep(int16_t wait)
+{
+  uint8_t us;
+
+  wait = (wait >> 3) - MOTOR_WAKE_EARLY;
+  if(wait <= 0)
+    return;
+  us = wait > MOTOR_WAKE_MAX ? MOTOR_WAKE_MAX : wait;
+
+  TIFR2 = _BV(OCF2A);
+  cli();
+  OCR2A = TCNT2 + us;
+  sei();
+
+  cli();
+  if(!(TIFR2 & _BV(OCF2A))) {
+    TIMSK2 = _BV(OCIE2A);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    TIMSK2 = 0;
+  }
+  sei();
+}
+
+/*
+ * Frames per pulse for an output rate (pulse loop skip count needed
+ * to avoid burning analog servos).
+ */
+static uint8_t motorsDivider(uint16_t rate)
+{
+  uint8_t divider;
+
+  for(divider = 1;divider < MOTOR_SLOTS;divider++)
+    if((uint32_t)divider * rate >= ESC_RATE)
       break;
+  return divider;
+}
+
+static uint8_t motorsGcd(uint8_t a, uint8_t b)
+{
+  while(b) {
+    uint8_t t = a % b;
+
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/*
+ * Fill in the output descriptors for the active frame (see
+ * mixerSetup()) and precompute what each frame writes: the compare
+ * output modes and per-port masks that turn the pins on, and the
+ * software pins to turn off.
+ */
+void motorsFrameSetup()
+{
+  uint8_t driven = Mixer.outputs > MIXER_MIRRORED ? Mixer.outputs : MIXER_MIRRORED;
+  uint8_t longest = 1;
+  uint16_t slots = 1;
+
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++) {
+    struct motorOutput *o = &MotorOutput[i];
+    uint8_t flags = Mixer.output[i].flags;
+    uint16_t rate = Config.OutputRate[i];
+
+    if(i >= driven) {
+      o->divider = 0;
+      continue;
+    }
+
+    if(!rate)
+      rate = (flags & MIXER_SLOW) ? SERVO_RATE : ESC_RATE;
+    o->divider = motorsDivider(rate);
+    if(o->divider > longest)
+      longest = o->divider;
+    if(slots <= MOTOR_SLOTS)
+      slots = slots / motorsGcd(slots, o->divider) * o->divider;
+  }
+
+  if(slots > MOTOR_SLOTS) {
+    for(uint8_t i = 0;i < driven;i++) {
+      while(longest % MotorOutput[i].divider)
+        MotorOutput[i].divider++;
+    }
+    slots = longest;
+  }
+  motorsSlots = slots;
+  motorsSlot = 0;
+
+  motorsSoftCount = 0;
+  for(uint8_t i = 0;i < driven;i++) {
+    if(pgm_read_byte(&motorsPin[i].compare) == MOTOR_SOFT) {
+      motorsSoft[motorsSoftCount] = i;
+      motorsSoftPort[motorsSoftCount] = pgm_read_byte(&motorsPin[i].port);
+      motorsSoftMask[motorsSoftCount] = pgm_read_byte(&motorsPin[i].mask);
+      motorsSoftCount++;
+    }
+  }
+
+  for(uint8_t slot = 0;slot < motorsSlots;slot++) {
+    motorsTCCR1A[slot] = _BV(COM1A1) | _BV(COM1B1);
+    motorsTCCR0A[slot] = _BV(COM0A1) | _BV(COM0B1);
+    motorsSoftB[slot] = 0;
+    motorsSoftD[slot] = 0;
+#ifdef LATENCY_TRACE
+    motorsOutputs[slot] = 0;
+#endif
+
+    for(uint8_t i = 0;i < driven;i++) {
+      uint8_t mask = pgm_read_byte(&motorsPin[i].mask);
+
+      if(slot % MotorOutput[i].divider)
+        continue;
+#ifdef LATENCY_TRACE
+      motorsOutputs[slot]|= _BV(i);
 #endif
 
+      switch(pgm_read_byte(&motorsPin[i].compare)) {
+      case MOTOR_SOFT:
+        if(pgm_read_byte(&motorsPin[i].port) == MOTOR_PORTB)
+          motorsSoftB[slot]|= mask;
+        else
+          motorsSoftD[slot]|= mask;
+        break;
+      case MOTOR_OC1A:
+        motorsTCCR1A[slot]|= _BV(COM1A0);
+        break;
+      case MOTOR_OC1B:
+        motorsTCCR1A[slot]|= _BV(COM1B0);
+        break;
+      case MOTOR_OC0A:
+        motorsTCCR0A[slot]|= _BV(COM0A0);
+        break;
+      case MOTOR_OC0B:
+        motorsTCCR0A[slot]|= _BV(COM0B0);
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * Sort this frame's software edges by time, merging pins on the same
+ * port that go low at the same tick into one write.
+ */
+static uint8_t motorsSoftEdges(struct motorEdge *edge)
+{
+  uint8_t edges = 0;
+
+  for(uint8_t i = 0;i < motorsSoftCount;i++) {
+    int16_t time = MotorOut[motorsSoft[i]];
+    uint8_t port = motorsSoftPort[i];
+    uint8_t j;
+
+    for(j = 0;j < edges;j++) {
+      if(edge[j].time == time && edge[j].port == port) {
+        edge[j].mask|= motorsSoftMask[i];
+        break;
+      }
+    }
+    if(j < edges)
+      continue;
+
+    for(j = edges;j > 0 && edge[j - 1].time > time;j--)
+      edge[j] = edge[j - 1];
+    edge[j].time = time;
+    edge[j].port = port;
+    edge[j].mask = motorsSoftMask[i];
+    edges++;
+  }
+
+  return edges;
 }
 
 void motorLoop()
@@ -49,67 +275,38 @@ void motorLoop()
 
 void output_motor_ppm()
 {
-  int16_t t;
+  int16_t t, end, wake;
+  uint8_t slot;
+  struct motorEdge edge[MOTOR_SOFT_PINS];
+  uint8_t edges, next;
+#ifdef SPECTRUM
+  int16_t last;
+#endif
 
   /*
-   * Bound pulse length to 1ms <= pulse <= 2ms.
+   * Bound pulse length to 1ms <= pulse <= 2ms (0 - 2ms for wide
+   * outputs) and convert to timer ticks.
    */
+  for(uint8_t i = 0;i < Mixer.outputs;i++) {
+    uint8_t flags = Mixer.output[i].flags;
 
-  t = 1000;
-  if(MotorOut1 < 0)
-    MotorOut1 = 0;
-  else if(MotorOut1 > t)
-    MotorOut1 = t;
-#ifdef SINGLE_COPTER
-  t = 2000;
-#endif
-  if(MotorOut2 < 0)
-    MotorOut2 = 0;
-  else if(MotorOut2 > t)
-    MotorOut2 = t;
-  if(MotorOut3 < 0)
-    MotorOut3 = 0;
-  else if(MotorOut3 > t)
-    MotorOut3 = t;
-  if(MotorOut4 < 0)
-    MotorOut4 = 0;
-  else if(MotorOut4 > t)
-    MotorOut4 = t;
-  if(MotorOut5 < 0)
-    MotorOut5 = 0;
-  else if(MotorOut5 > t)
-    MotorOut5 = t;
-  if(MotorOut6 < 0)
-    MotorOut6 = 0;
-  else if(MotorOut6 > t)
-    MotorOut6 = t;
-
-  t = 1000;
-  MotorOut1+= t;
-#ifndef SINGLE_COPTER
-  MotorOut2+= t;
-  MotorOut3+= t;
-  MotorOut4+= t;
-  MotorOut5+= t;
-  MotorOut6+= t;
-#endif
-
-  MotorOut1<<= 3;
-  MotorOut2<<= 3;
-  MotorOut3<<= 3;
-  MotorOut4<<= 3;
-  MotorOut5<<= 3;
-  MotorOut6<<= 3;
+    t = MotorOut[i];
+    if(t < 0)
+      t = 0;
+    else if(t > MIXER_RANGE(flags))
+      t = MIXER_RANGE(flags);
+    MotorOut[i] = (t + MIXER_BASE(flags)) << 3;
+  }
 
   /*
    * Mirror M3, M4 to M5, M6, when possible, for hardware PPM
-   * support. The compiler will throw away the above operations on
-   * M5 and M6 when it sees these.
+   * support.
    */
-#if defined(DUAL_COPTER) || defined(TRI_COPTER) || defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER)
-  MotorOut5 = MotorOut3;
-  MotorOut6 = MotorOut4;
-#endif
+  for(uint8_t i = Mixer.outputs;i < MIXER_MIRRORED;i++)
+    MotorOut[i] = MotorOut[i - 2];
+
+  edges = motorsSoftEdges(edge);
+  next = 0;
 
   /*
    * We can use timer compare output mode to provide jitter-free
@@ -137,6 +334,11 @@ void output_motor_ppm()
    * M4 (PD7): software only
    * M5 (PD6): OCR0A (COM0A) 8-bit
    * M6 (PD5): OCR0B (COM0B) 8-bit
+   * M7 (PB3): software only
+   * M8 (PB4): software only
+   *
+   * Software pins are turned off in time order, one port write for
+   * pins on the same port due at the same tick (see motorsPin[]).
    *
    * We must disable interrupts while setting the 16-bit registers
    * to avoid Rx interrupts clobbering the internal temporary
@@ -146,12 +348,12 @@ void output_motor_ppm()
    *
    * We turn OFF the pins here, then wait for the ON cycle start.
    */
-  t = MotorStartTCNT1 + MotorOut1;
+  t = MotorStartTCNT1 + MotorOut[0];
   asm(""::"r" (t)); /* Avoid reordering of add after cli */
   cli();
   OCR1B = t;
   sei();
-  t = MotorStartTCNT1 + MotorOut2;
+  t = MotorStartTCNT1 + MotorOut[1];
   asm(""::"r" (t)); /* Avoid reordering of add after cli */
   cli();
   OCR1A = t;
@@ -165,24 +367,63 @@ void output_motor_ppm()
    *
    * We hope that TCNT0 and TCNT1 are always synchronized.
    */
-  OCR0A = MotorStartTCNT1 + MotorOut5;
-  OCR0B = MotorStartTCNT1 + MotorOut6;
+  OCR0A = MotorStartTCNT1 + MotorOut[4];
+  OCR0B = MotorStartTCNT1 + MotorOut[5];
 
+#ifdef SPECTRUM
+  /*
+   * Time after which this loop has no more edges to make: idle work
+   * may only run past this point.
+   */
+  last = edges ? edge[edges - 1].time : 0;
+  if(MotorOut[4] - 0xff > last)
+    last = MotorOut[4] - 0xff;
+  if(MotorOut[5] - 0xff > last)
+    last = MotorOut[5] - 0xff;
+#endif
+
+  /*
+   * Make the edges in time order, sleeping in between until the next
+   * one is due (see motorsSleep()).
+   */
+  end = ((2000 + PWM_LOW_PULSE_US) << 3) - 0xff;
   do {
     cli();
     t = TCNT1;
     sei();
     t-= MotorStartTCNT1;
-    if(t >= MotorOut3)
-      M3 = 0;
-    if(t >= MotorOut4)
-      M4 = 0;
-    if(t + 0xff >= MotorOut5)
-      TCCR0A&= ~_BV(COM0A0);  /* Clear pin on match */
-    if(t + 0xff >= MotorOut6)
-      TCCR0A&= ~_BV(COM0B0);  /* Clear pin on match */
-    t-= ((2000 + PWM_LOW_PULSE_US) << 3) - 0xff;
-  } while(t < 0);
+    while(next < edges && t >= edge[next].time) {
+      if(edge[next].port == MOTOR_PORTB)
+        PORTB&= ~edge[next].mask;
+      else
+        PORTD&= ~edge[next].mask;
+      if((uint16_t)(t - edge[next].time) > MotorSoftLateMax)
+        MotorSoftLateMax = t - edge[next].time;
+      next++;
+    }
+    wake = end;
+    if(next < edges && edge[next].time < wake)
+      wake = edge[next].time;
+    if(TCCR0A & _BV(COM0A0)) {
+      if(t + 0xff >= MotorOut[4])
+        TCCR0A&= ~_BV(COM0A0);  /* Clear pin on match */
+      else if(MotorOut[4] - 0xff < wake)
+        wake = MotorOut[4] - 0xff;
+    }
+    if(TCCR0A & _BV(COM0B0)) {
+      if(t + 0xff >= MotorOut[5])
+        TCCR0A&= ~_BV(COM0B0);  /* Clear pin on match */
+      else if(MotorOut[5] - 0xff < wake)
+        wake = MotorOut[5] - 0xff;
+    }
+#ifdef SPECTRUM
+    if(SpectrumEnabled && t >= last && t - end < -SPECTRUM_IDLE_TICKS) {
+      spectrumIdle();
+      continue;
+    }
+#endif
+    motorsSleep(wake - t);
+  } while(t < end);
 
   /*
    * We should now be <= 0xff ticks before the next on cycle.
@@ -198,23 +439,30 @@ void output_motor_ppm()
    */
 
   MotorStartTCNT1+= (2000 + PWM_LOW_PULSE_US) << 3;
-#if 0
+  wdt_reset();
   cli();
   t = TCNT1;
   sei();
-  t+= 0x3f;
+  t+= MOTOR_DEADLINE_MARGIN;
   t-= MotorStartTCNT1;
   if(t >= 0) {
     /*
-     * We've already passed the on cycle, hmm.
-     * Push it into the future.
+     * We've already passed the on cycle: the compare would not match
+     * until timer1 wraps. Count the overrun and push the on time
+     * into the future.
      */
-    cli();
-    t = TCNT1;
-    sei();
-    MotorStartTCNT1 = t + 0xff;
+    if(MotorDeadline.overruns != UINT16_MAX)
+      MotorDeadline.overruns++;
+    if((uint16_t)t > MotorDeadline.lateMax)
+      MotorDeadline.lateMax = t;
+    if(MotorDeadline.missed != UINT8_MAX)
+      MotorDeadline.missed++;
+    if(MotorDeadline.missed > MotorDeadline.missedMax)
+      MotorDeadline.missedMax = MotorDeadline.missed;
+    MotorStartTCNT1+= t + 0xff - MOTOR_DEADLINE_MARGIN;
+  } else {
+    MotorDeadline.missed = 0;
   }
-#endif
   t = MotorStartTCNT1;
   cli();
   OCR1B = t;
@@ -225,39 +473,9 @@ void output_motor_ppm()
   OCR1A = t;
   sei();
 
-#ifdef SINGLE_COPTER
-  if(servo_skip == 0) {
-    TCCR1A = _BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0);
-//    TCCR1C = _BV(FOC1A) | _BV(FOC1B);
-    TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
-//    TCCR0B = _BV(CS00) | _BV(FOC0A) | _BV(FOC0B);
-  } else {
-    TCCR1A = _BV(COM1A1) | _BV(COM1B1) | _BV(COM1B0);
-//    TCCR1C = _BV(FOC1A) | _BV(FOC1B);
-  }
-#elif defined(DUAL_COPTER) || defined(TWIN_COPTER)
-  TCCR1A = _BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0);
-//  TCCR1C = _BV(FOC1A) | _BV(FOC1B);
-  if(servo_skip == 0) {
-    TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
-//    TCCR0B = _BV(CS00) | _BV(FOC0A) | _BV(FOC0B);
-  }
-#elif defined(TRI_COPTER)
-  TCCR1A = _BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0);
-//  TCCR1C = _BV(FOC1A) | _BV(FOC1B);
-  if(servo_skip == 0) {
-    TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
-//    TCCR0B = _BV(CS00) | _BV(FOC0A) | _BV(FOC0B);
-  } else {
-    TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1);
-//    TCCR0B = _BV(CS00) | _BV(FOC0A) | _BV(FOC0B);
-  }
-#elif defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER) || defined(HEX_COPTER) || defined(Y6_COPTER)
-  TCCR1A = _BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0);
-//  TCCR1C = _BV(FOC1A) | _BV(FOC1B);
-  TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
-//  TCCR0B = _BV(CS00) | _BV(FOC0A) | _BV(FOC0B);
-#endif
+  slot = motorsSlot;
+  TCCR1A = motorsTCCR1A[slot];
+  TCCR0A = motorsTCCR0A[slot];
 
   /*
    * Wait for the on time so we can turn on the software pins.
@@ -267,84 +485,127 @@ void output_motor_ppm()
     t = TCNT1;
     sei();
     t-= MotorStartTCNT1;
+    motorsSleep(-t);
   } while(t < 0);
 
-#ifdef SINGLE_COPTER
-  if(servo_skip == 0) {
-    M3 = 1;
-    M4 = 1;
-    servo_skip = servo_skip_divider;
-  }
-  servo_skip--;
-#elif defined(DUAL_COPTER) || defined(TWIN_COPTER)
-  if(servo_skip == 0) {
-    M3 = 1;
-    M4 = 1;
-    servo_skip = servo_skip_divider;
-  }
-  servo_skip--;
-#elif defined(TRI_COPTER)
-  M3 = 1;
-  if(servo_skip == 0) {
-    M4 = 1;
-    servo_skip = servo_skip_divider;
-  }
-  servo_skip--;
-#elif defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER) || defined(HEX_COPTER) || defined(Y6_COPTER)
-  M3 = 1;
-  M4 = 1;
+  PORTB|= motorsSoftB[slot];
+  PORTD|= motorsSoftD[slot];
+  if(++motorsSlot >= motorsSlots)
+    motorsSlot = 0;
+
+#ifdef LATENCY_TRACE
+  latencyPulse(motorsPulsing);
+  motorsPulsing = motorsOutputs[slot];
 #endif
+
+  timersUpdate();
   /*
    * We leave with the output pins ON.
    */
 }
 
+#ifdef TELEMETRY
+/*
+ * Send the frame deadline statistics (TELEMETRY_DEADLINE). A record
+ * that does not fit is dropped, never waited for.
+ */
+void motorsDeadlineSend()
+{
+  telemetrySend(TELEMETRY_DEADLINE, &MotorDeadline, sizeof(MotorDeadline));
+}
+#endif
+
+/*
+ * One frame with every output stopped (ESCs at zero throttle, servos
+ * at their stop value). The setup modes call this on every pass, so
+ * the ESCs stay fed and the timers keep running.
+ */
+void motorsStopFrame()
+{
+  mixerStop(false);
+  output_motor_ppm();
+}
+
+/*
+ * Keep the outputs stopped for `frames` frames (see TIMER_MS()).
+ */
+void motorsStopWait(uint16_t frames)
+{
+  timersStart(TIMER_MODE, frames, 0);
+  while(!timersFired(TIMER_MODE))
+    motorsStopFrame();
+}
+
+/*
+ * Blink and spin each output in turn. A full roll stick deflection
+ * (after returning to centre) steps to the next/previous frame type,
+ * which is saved and takes effect immediately. Until a full yaw
+ * deflection confirms the wiring (or the next power on), every
+ * output the new frame does not drive as a motor stays at ESC zero:
+ * it may still have an ESC of the old frame on it, and a servo stop
+ * value (1.5ms) is half throttle to an ESC.
+ */
 void motorsIdentify()
 {
   LED = 0;
   int8_t motor = 0;
-  uint16_t delay = 0;
-  uint16_t time = TCNT2;
   bool escInit = true;      // Wait until the ESCs have initialized
+  bool centred = false;
+  bool servos = true;       // Non-motor outputs at their stop values
 
-  while(1) {
-    delay += (uint8_t)(TCNT2 - time);
-    time = TCNT2;
+  timersStart(TIMER_MODE, TIMER_MS(3000), 0);
 
-    if(escInit) {
-      if(delay > 23437) {    // 3.00 second delay (3.00 / .000128 = 23437.5)
+  while(1) {
+    /*
+     * ESC init (3s), then each output in turn: LED off for 1s, then
+     * LED on and the output spinning for 0.15s.
+     */
+    if(timersFired(TIMER_MODE)) {
+      if(escInit) {
         escInit = false;
-        delay = 0;
-      }
-    } else if(LED) {
-      if(delay > 1171) {    // 0.15 second delay (0.15 / .000128 = 1171.8)
-        if(++motor > 6) {
+      } else if(LED) {
+        if(++motor > (Mixer.outputs > MIXER_MIRRORED ? Mixer.outputs : MIXER_MIRRORED)) {
           motor = 0;
         }
-        delay = 0;
-        LED = !LED;
-      }
-    } else {
-      if(delay > 7812) {    // 1.00 second delay (1.00 / .000128 = 7812.5)
-        delay = 0;
-        LED = !LED;
+        LED = 0;
+      } else {
+        LED = 1;
       }
+      timersStart(TIMER_MODE, LED ? TIMER_MS(150) : TIMER_MS(1000), 0);
+    }
+
+    RxGetChannels();
+    if(abs(RxInRoll) < STICK_THROW / 2 && abs(RxInYaw) < STICK_THROW / 2)
+      centred = true;
+    else if(centred && abs(RxInYaw) > STICK_THROW) {
+      servos = true;
+      centred = false;
+    } else if(centred && abs(RxInRoll) > STICK_THROW) {
+      uint8_t frame = Config.FrameType;
+
+      if(!mixerFrameFits(frame))
+        frame = FRAME_DEFAULT;
+      do {
+        if(RxInRoll > 0)
+          frame = frame == FRAME_TYPES - 1 ? 0 : frame + 1;
+        else
+          frame = frame == 0 ? FRAME_TYPES - 1 : frame - 1;
+      } while(!mixerFrameFits(frame));
+      Config.FrameType = frame;
+      Save_Config_to_EEPROM();    // Stopped frames of the old frame
+      mixerSetup();
+      servos = false;
+      centred = false;
+      motor = 0;
     }
 
-    MotorOut1 = 0;
-    MotorOut2 = 0;
-    MotorOut3 = 0;
-    MotorOut4 = 0;
-    MotorOut5 = 0;
-    MotorOut6 = 0;
-
-    if(LED) {
-      if(motor == 1) { MotorOut1 = 50; }
-      if(motor == 2) { MotorOut2 = 50; }
-      if(motor == 3) { MotorOut3 = 50; }
-      if(motor == 4) { MotorOut4 = 50; }
-      if(motor == 5) { MotorOut5 = 50; }
-      if(motor == 6) { MotorOut6 = 50; }
+    for(uint8_t i = 0;i < MIXER_OUTPUTS;i++) {
+      if(!(Mixer.output[i].flags & MIXER_MOTOR))
+        MotorOut[i] = servos ? Mixer.output[i].stop : 0;
+      else if(LED && motor == i + 1)
+        MotorOut[i] = 50;
+      else
+        MotorOut[i] = 0;
     }
 
     output_motor_ppm();
@@ -353,54 +614,20 @@ void motorsIdentify()
 
 void motorsThrottleCalibration()
 {
-  // flash LED 3 times
-  for(uint8_t i = 0;i < 3;i++) {
-    LED = 1;
-    _delay_ms(25);
-    LED = 0;
-    _delay_ms(25);
-  }
+  struct mixerInput in = { 0, 0, 0, 0 };
+
+  timersFlash(3);    // While the throttle already goes out
 
   while(1) {
     RxGetChannels();
-#ifdef SINGLE_COPTER
-    MotorOut1 = RxInCollective;
-    MotorOut2 = 1400;    // Center: 140
-    MotorOut3 = 1400;
-    MotorOut4 = 1400;
-    MotorOut5 = 1400;
-#elif defined(DUAL_COPTER)
-    MotorOut1 = RxInCollective;
-    MotorOut2 = RxInCollective;
-    MotorOut3 = 500;    // Center: 50
-    MotorOut4 = 500;
-#elif defined(TWIN_COPTER)
-    MotorOut1 = RxInCollective;
-    MotorOut2 = RxInCollective;
-    MotorOut3 = 500;    // Center: 50
-    MotorOut4 = 500;
-    MotorOut5 = 500;
-    MotorOut6 = 500;    // Center: 50, Reverse
-#elif defined(TRI_COPTER)
-    MotorOut1 = RxInCollective;
-    MotorOut2 = RxInCollective;
-    MotorOut3 = RxInCollective;
-    MotorOut4 = 500+RxInYaw*2;    // Center: 50
-#elif defined(QUAD_COPTER) || defined(QUAD_X_COPTER) || defined(Y4_COPTER)
-    MotorOut1 = RxInCollective;
-    MotorOut2 = RxInCollective;
-    MotorOut3 = RxInCollective;
-    MotorOut4 = RxInCollective;
-#elif defined(HEX_COPTER) ||  defined(Y6_COPTER)
-    MotorOut1 = RxInCollective;
-    MotorOut2 = RxInCollective;
-    MotorOut3 = RxInCollective;
-    MotorOut4 = RxInCollective;
-    MotorOut5 = RxInCollective;
-    MotorOut6 = RxInCollective;
-#else
-#error No Copter configuration defined !!!!
-#endif
+    in.yaw = RxInYaw;
+    mixerMix(&in);    // Servos centred, tail follows yaw
+    for(uint8_t i = 0;i < Mixer.outputs;i++) {
+      if(Mixer.output[i].flags & MIXER_MOTOR)
+        MotorOut[i] = RxInCollective;
+      else if(Config.FrameType == FRAME_SINGLE && i <= 4)
+        MotorOut[i] = MOTOR_CALIBRATION_SINGLE_SERVO;
+    }
     output_motor_ppm();  // this regulates rate at which we output signals
   }
 }
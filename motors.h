@@ -1,7 +1,9 @@
 #ifndef MOTORS_H
 #define MOTORS_H
 
+#include <avr/wdt.h>
 #include "config.h"
+#include "receiver.h"
 
 /*** BEGIN DEFINES ***/
 //#define SERVO_REVERSE
@@ -24,6 +26,91 @@ Check it out
 
 // NOTE: Set to 50 for analog servos, 250 for digital servos.
 #define SERVO_RATE 50  // in Hz
+
+/*
+ * Single copter vane servos (M2-M5) during throttle calibration, as
+ * they have always been held there: not the flight centres (840, 945).
+ */
+#define MOTOR_CALIBRATION_SINGLE_SERVO 1400
+
+/*
+ * Outputs M1..M8. M7 and M8 (PB3, PB4) are only there when the Rx
+ * aux channels 3 and 4 do not use those pins; frames with more
+ * outputs than MOTOR_PINS cannot be selected. The MINIMAL build,
+ * which has only the default frame, keeps M7 and M8 for the frames
+ * that need them.
+ */
+#define MOTOR_OUTPUTS_ALL 8          // Saved settings have all of them
+#if defined(MINIMAL) && !defined(OCTO_COPTER) && !defined(X8_COPTER)
+#define MOTOR_OUTPUTS 6
+#else
+#define MOTOR_OUTPUTS 8
+#endif
+#if RX_AUX_PINS > 2 || MOTOR_OUTPUTS < 8
+#define MOTOR_PINS 6
+#else
+#define MOTOR_PINS 8
+#endif
+
+#define MOTOR_PORTB 0
+#define MOTOR_PORTD 1
+
+// How an output pin is driven
+#define MOTOR_SOFT 0                 // Port write in output_motor_ppm()
+#define MOTOR_OC1A 1                 // Timer compare output
+#define MOTOR_OC1B 2
+#define MOTOR_OC0A 3
+#define MOTOR_OC0B 4
+
+#if MOTOR_OUTPUTS > 6
+#define MOTOR_SOFT_PINS 4            // M3, M4, M7, M8
+#else
+#define MOTOR_SOFT_PINS 2            // M3, M4
+#endif
+
+/*
+ * Output rate schedule. Each output pulses every `divider` frames,
+ * the smallest divider that keeps it at or below its rate (ESC_RATE
+ * for motors and SERVO_RATE for servos, unless Config.OutputRate[]
+ * sets one). The compare modes and port masks for every frame of the
+ * schedule are built ahead, so a frame only looks them up. The
+ * schedule is as long as the least common multiple of the dividers;
+ * if that exceeds MOTOR_SLOTS, dividers are raised to divide the
+ * largest one (outputs only ever get slower). No divider goes above
+ * MOTOR_SLOTS.
+ */
+#ifdef MINIMAL
+#define MOTOR_SLOTS 9
+#else
+#define MOTOR_SLOTS 24
+#endif
+
+/*
+ * The output stage waits asleep (idle mode) rather than polling
+ * timer1. timer2 runs at 1MHz and its compare A interrupt wakes the
+ * CPU MOTOR_WAKE_EARLY us before the next edge to make; so does any
+ * other interrupt. Only that last stretch is polled.
+ */
+#define MOTOR_WAKE_EARLY 3           // us
+#define MOTOR_WAKE_MAX 0xf0          // us, longest single sleep
+
+/*
+ * Frame deadline: the next frame's compare values must be set up
+ * before its on time. A frame that gets there later is an overrun;
+ * its on time is pushed out to make a whole pulse (see
+ * MotorDeadline).
+ *
+ * The hardware watchdog is reset once per frame, so a loop that
+ * stops making frames resets the MCU, and the ESCs lose their
+ * signal, within MOTOR_WDT_TIMEOUT. The longest stretch without
+ * frames is arming (gyro calibration and table builds), ~50ms.
+ */
+#define MOTOR_DEADLINE_MARGIN 0x3f   // timer1 ticks before the on time
+#define MOTOR_WDT_TIMEOUT WDTO_120MS
+
+#if MOTOR_SLOTS * SERVO_RATE < ESC_RATE
+#error "MOTOR_SLOTS is too short to slow servos down to SERVO_RATE"
+#endif
 /*** END DEFINES ***/
 
 /*** BEGIN HELPER MACROS ***/
@@ -37,26 +124,57 @@ Check it out
 #endif
 /*** END HELPER MACROS ***/
 
+/*** BEGIN TYPES ***/
+struct motorPin {
+  uint8_t port;                      // MOTOR_PORTB or MOTOR_PORTD
+  uint8_t mask;
+  uint8_t compare;                   // MOTOR_SOFT or MOTOR_OCnx
+};
+
+/*
+ * Per-output setup for the active frame (see motorsFrameSetup()).
+ */
+struct motorOutput {
+  uint8_t divider;                   // Frames per pulse, 0 = not driven
+};
+
+// Software edge, M3/M4/M7/M8 pins going low together
+struct motorEdge {
+  int16_t time;                      // Ticks after the frame start
+  uint8_t port;
+  uint8_t mask;
+};
+
+/*
+ * Frame deadline statistics, also the TELEMETRY_DEADLINE payload.
+ */
+struct motorDeadline {
+  uint16_t overruns;                 // Frames that missed the deadline
+  uint16_t lateMax;                  // Worst lateness, timer1 ticks
+  uint8_t missed;                    // Consecutive overruns so far
+  uint8_t missedMax;                 // Longest run of overruns
+  uint8_t resetCause;                // MCUSR at boot (WDRF: watchdog)
+};
+/*** END TYPES ***/
+
 /*** BEGIN VARIABLES ***/
-extern int16_t MotorOut1;
-extern int16_t MotorOut2;
-extern int16_t MotorOut3;
-extern int16_t MotorOut4;
-extern int16_t MotorOut5;
-extern int16_t MotorOut6;
+extern int16_t MotorOut[MOTOR_OUTPUTS];  // M1..M8
 extern int16_t MotorStartTCNT1;
-#if defined(SINGLE_COPTER) || defined(DUAL_COPTER) || defined(TWIN_COPTER) || defined(TRI_COPTER)
-extern uint8_t servo_skip;
-extern uint16_t servo_skip_divider;
-#endif
+extern struct motorOutput MotorOutput[MOTOR_OUTPUTS];
+extern uint16_t MotorSoftLateMax;    // Latest software edge, timer1 ticks
+extern struct motorDeadline MotorDeadline;
 /*** END VARIABLES ***/
 
 /*** BEGIN PROTOTYPES ***/
 void motorsSetup(void);
+void motorsFrameSetup(void);
 void motorLoop(void);
 void motorsIdentify(void);
 void motorsThrottleCalibration(void);
+void motorsStopFrame(void);
+void motorsStopWait(uint16_t frames);
 void output_motor_ppm(void);
+void motorsDeadlineSend(void);
 /*** END PROTOTYPES ***/
 
 #endif
@@ -0,0 +1,241 @@
+#include "mpu6050.h"
+
+#include "gyros.h"
+
+#ifdef GYRO_MPU6050
+#include <util/twi.h>
+#include "receiver.h"
+
+/*
+ * MPU-6050 on the TWI bus (SDA PC4, SCL PC5), data-ready on PC0.
+ *
+ * Each data-ready edge starts a burst read of all sensor registers,
+ * which is then run entirely from the TWI interrupt, so loop() never
+ * waits on the bus. Completed samples are copied under the i_sreg
+ * retry used for the Rx channels.
+ */
+
+/*** BEGIN VARIABLES ***/
+int16_t MpuGyro[3];
+int16_t MpuAcc[3];
+volatile uint8_t MpuSamples;
+uint16_t MpuErrors;
+
+enum mpuOp { MPU_IDLE = 0, MPU_WRITE, MPU_READ };
+
+static volatile uint8_t mpuOp;
+static uint8_t mpuReg;               // Register to write or read from
+static uint8_t mpuValue;             // Value to write
+static uint8_t mpuIndex;             // Bytes done in this transfer
+static uint8_t mpuBuffer[MPU_SAMPLE_SIZE];
+static uint8_t mpuSample[2][MPU_SAMPLE_SIZE];
+static uint8_t mpuFront;
+static uint8_t mpuLoopSamples;       // MpuSamples at the last loop
+static uint8_t mpuStale;             // Loops in a row without a sample
+/*** END VARIABLES ***/
+
+struct mpuWait {
+  uint16_t last;                     // timer1 time counted to
+  uint16_t us;                       // Waited so far
+};
+
+#define TWI_GO (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+
+static void mpuStart(uint8_t op, uint8_t reg)
+{
+  mpuOp = op;
+  mpuReg = reg;
+  mpuIndex = 0;
+  TWCR = TWI_GO | _BV(TWSTA);
+}
+
+static inline void mpuStop(void)
+{
+  TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+  mpuOp = MPU_IDLE;
+}
+
+ISR(TWI_vect)
+{
+  switch(TW_STATUS) {
+  case TW_START:
+    TWDR = (MPU_ADDRESS << 1) | TW_WRITE;
+    TWCR = TWI_GO;
+    break;
+  case TW_REP_START:
+    TWDR = (MPU_ADDRESS << 1) | TW_READ;
+    TWCR = TWI_GO;
+    break;
+  case TW_MT_SLA_ACK:
+    TWDR = mpuReg;
+    TWCR = TWI_GO;
+    break;
+  case TW_MT_DATA_ACK:
+    if(mpuOp == MPU_READ) {
+      TWCR = TWI_GO | _BV(TWSTA);    // Repeated start for the read
+    } else if(mpuIndex == 0) {
+      TWDR = mpuValue;
+      mpuIndex++;
+      TWCR = TWI_GO;
+    } else {
+      mpuStop();
+    }
+    break;
+  case TW_MR_SLA_ACK:
+    TWCR = TWI_GO | _BV(TWEA);
+    break;
+  case TW_MR_DATA_ACK:
+    mpuBuffer[mpuIndex++] = TWDR;
+    if(mpuIndex < MPU_SAMPLE_SIZE - 1)
+      TWCR = TWI_GO | _BV(TWEA);
+    else
+      TWCR = TWI_GO;                 // NACK the last byte
+    break;
+  case TW_MR_DATA_NACK:
+    mpuBuffer[mpuIndex] = TWDR;
+    mpuStop();
+    for(uint8_t i = 0;i < MPU_SAMPLE_SIZE;i++)
+      mpuSample[mpuFront ^ 1][i] = mpuBuffer[i];
+    mpuFront^= 1;
+    MpuSamples++;
+    i_sreg = 0;                      // Make a concurrent mpuRead() retry
+    break;
+  default:
+    MpuErrors++;
+    mpuStop();
+    break;
+  }
+}
+
+/*
+ * Data-ready from the sensor. Skip the sample if the previous burst
+ * is still running.
+ */
+ISR(PCINT1_vect)
+{
+  if(MPU_INT && mpuOp == MPU_IDLE)
+    mpuStart(MPU_READ, MPU_REG_ACCEL_XOUT_H);
+}
+
+/*
+ * Bounded waits: false until MPU_WAIT_US have passed since
+ * mpuWaitStart(). timer1 wraps every 8.2ms, so the time is added up
+ * on every call.
+ */
+static void mpuWaitStart(struct mpuWait *w)
+{
+  cli();
+  w->last = TCNT1;
+  sei();
+  w->us = 0;
+}
+
+static bool mpuWaitOver(struct mpuWait *w)
+{
+  uint16_t now, us;
+
+  cli();
+  now = TCNT1;
+  sei();
+  us = (uint16_t)(now - w->last) >> 3;
+  w->last+= us << 3;
+  w->us+= us;
+  return w->us > MPU_WAIT_US;
+}
+
+static void mpuWrite(uint8_t reg, uint8_t value)
+{
+  struct mpuWait w;
+
+  mpuValue = value;
+  mpuWaitStart(&w);
+  mpuStart(MPU_WRITE, reg);
+  while(mpuOp != MPU_IDLE || (TWCR & _BV(TWSTO))) {
+    if(mpuWaitOver(&w)) {
+      MpuErrors++;
+      cli();
+      mpuStop();                     // Release the bus, if it still can
+      sei();
+      return;
+    }
+  }
+}
+
+/*
+ * Configure the bus and the sensor. Interrupts must be enabled; this
+ * is the only place that waits on the bus. A sensor that does not
+ * answer leaves MpuErrors counted and no samples.
+ */
+void mpuSetup()
+{
+  MPU_INT_DIR = INPUT;
+
+  TWSR = 0;                          // Prescaler 1
+  TWBR = (F_CPU / MPU_TWI_HZ - 16) / 2;
+
+  mpuWrite(MPU_REG_PWR_MGMT_1, 0x01);        // Wake, PLL on gyro X
+  mpuWrite(MPU_REG_SMPLRT_DIV, MPU_SMPLRT_DIV);
+  mpuWrite(MPU_REG_CONFIG, MPU_DLPF);
+  mpuWrite(MPU_REG_GYRO_CONFIG, MPU_GYRO_FS);
+  mpuWrite(MPU_REG_ACCEL_CONFIG, MPU_ACCEL_FS);
+  mpuWrite(MPU_REG_INT_PIN_CFG, 0x10);       // Clear on any read
+  mpuWrite(MPU_REG_INT_ENABLE, 0x01);        // Data ready
+
+  PCMSK1 = _BV(PCINT8);              // PC0
+  PCICR|= _BV(PCIE1);
+}
+
+/*
+ * Copy the last complete sample into MpuGyro[] and MpuAcc[].
+ */
+void mpuRead()
+{
+  const uint8_t *b;
+  uint8_t t = 0xff;
+
+  do {
+    rxArmRetry(t);
+    b = mpuSample[mpuFront];
+    for(uint8_t i = 0;i < 3;i++) {
+      MpuAcc[i] = (b[i * 2] << 8) | b[i * 2 + 1];
+      MpuGyro[i] = (b[8 + i * 2] << 8) | b[8 + i * 2 + 1];
+    }
+  } while(i_sreg != t);
+}
+
+/*
+ * Wait for a sample newer than the last one; false, counted in
+ * MpuErrors, if none comes within MPU_WAIT_US.
+ */
+bool mpuWaitSample()
+{
+  struct mpuWait w;
+  uint8_t samples = MpuSamples;
+
+  mpuWaitStart(&w);
+  while(MpuSamples == samples) {
+    if(mpuWaitOver(&w)) {
+      MpuErrors++;
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Once a loop: count a loop that finds no sample newer than the last
+ * loop's in MpuErrors; true once MPU_STALE_LOOPS have in a row.
+ */
+bool mpuStalled()
+{
+  if(MpuSamples != mpuLoopSamples) {
+    mpuLoopSamples = MpuSamples;
+    mpuStale = 0;
+    return false;
+  }
+  MpuErrors++;
+  if(mpuStale < MPU_STALE_LOOPS)
+    mpuStale++;
+  return mpuStale >= MPU_STALE_LOOPS;
+}
+#endif
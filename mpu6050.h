@@ -0,0 +1,76 @@
+#ifndef MPU6050_H
+#define MPU6050_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+#define MPU_ADDRESS 0x68             // AD0 low
+
+// Registers
+#define MPU_REG_SMPLRT_DIV 0x19
+#define MPU_REG_CONFIG 0x1a
+#define MPU_REG_GYRO_CONFIG 0x1b
+#define MPU_REG_ACCEL_CONFIG 0x1c
+#define MPU_REG_INT_PIN_CFG 0x37
+#define MPU_REG_INT_ENABLE 0x38
+#define MPU_REG_ACCEL_XOUT_H 0x3b
+#define MPU_REG_PWR_MGMT_1 0x6b
+
+/*
+ * 1kHz internal rate / (1 + 1) = 500Hz data-ready, just above
+ * ESC_RATE; the 14-byte burst takes ~0.8ms at 200kHz. 94Hz DLPF,
+ * +-2000 deg/s, +-8g (4096 LSB/g).
+ */
+#define MPU_SMPLRT_DIV 1
+#define MPU_DLPF 2
+#define MPU_GYRO_FS 0x18
+#define MPU_ACCEL_FS 0x10
+#define MPU_ACC_1G 4096
+#define MPU_RATE_HZ (1000 / (1 + MPU_SMPLRT_DIV))
+#define MPU_GYRO_LSB_X10 164         // 16.4 LSB per deg/s
+
+#define MPU_TWI_HZ 200000
+
+#define MPU_SAMPLE_SIZE 14           // Accel, temperature, gyro
+
+/*
+ * Longest wait for a register write or a new sample: five sample
+ * periods. A sensor that does not answer in time is counted in
+ * MpuErrors, and the copter will not arm (see CalibrateGyros()).
+ */
+#define MPU_WAIT_US 10000
+
+/*
+ * Loops in a row without a new sample before mpuStalled() gives the
+ * sensor up in flight, about MPU_WAIT_US at ESC_RATE. Samples come a
+ * little faster than loops, so one is already missing.
+ */
+#define MPU_STALE_LOOPS 5
+
+/*
+ * Gyro counts are shifted down to about the 0.13 LSB per deg/s of the
+ * analog gyros, so the gain pots keep their meaning.
+ */
+#define MPU_GYRO_SHIFT 7
+
+// Sensor axis (0 = X, 1 = Y, 2 = Z) for each of our axes
+#define MPU_ROLL_AXIS 0
+#define MPU_PITCH_AXIS 1
+#define MPU_YAW_AXIS 2
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern int16_t MpuGyro[3];           // Last sample, sensor axes
+extern int16_t MpuAcc[3];
+extern volatile uint8_t MpuSamples;         // Completed burst reads
+extern uint16_t MpuErrors;           // Bus errors, NACKs and timeouts
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void mpuSetup(void);
+void mpuRead(void);
+bool mpuWaitSample(void);
+bool mpuStalled(void);
+/*** END PROTOTYPES ***/
+
+#endif
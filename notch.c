@@ -0,0 +1,116 @@
+#include "notch.h"
+
+#ifdef GYRO_NOTCH
+#include "motors.h"
+#include "settings.h"
+#include "trig.h"
+
+/*** BEGIN VARIABLES ***/
+struct notchCoef NotchCoef = { NOTCH_ONE, 0, 0, 0 };
+struct notchState NotchState[3];
+uint8_t NotchFreq;
+
+static uint8_t notchStage;           // Retune step, 0 = idle
+static uint8_t notchTarget;          // Frequency being tuned to
+static int16_t notchCos;             // cos(w), Q14
+static struct notchCoef notchNext;
+/*** END VARIABLES ***/
+
+/*
+ * Centre frequency for a collective value, from the Config map,
+ * within NOTCH_F_MIN..NOTCH_F_MAX; 0 for off.
+ */
+static uint8_t notchMap(int16_t collective)
+{
+  uint8_t i, f0, f1, f;
+
+  if(collective < 0)
+    collective = 0;
+  i = collective >> NOTCH_SHIFT;
+  if(i >= NOTCH_POINTS - 1) {
+    f = Config.NotchFreq[NOTCH_POINTS - 1];
+  } else {
+    f0 = Config.NotchFreq[i];
+    f1 = Config.NotchFreq[i + 1];
+    if(!f0 || !f1)
+      return 0;
+    f = f0 + (((int16_t)(f1 - f0) * (uint8_t)collective) >> NOTCH_SHIFT);
+  }
+
+  if(!f)
+    return 0;
+  if(f < NOTCH_F_MIN)
+    f = NOTCH_F_MIN;
+  else if(f > NOTCH_F_MAX)
+    f = NOTCH_F_MAX;
+  return f;
+}
+
+/*
+ * Back to bypass with empty filter state; the next notchUpdate()
+ * calls tune it again.
+ */
+void notchReset()
+{
+  for(uint8_t i = 0;i < 3;i++) {
+    NotchState[i].x1 = NotchState[i].x2 = 0;
+    NotchState[i].y1 = NotchState[i].y2 = 0;
+  }
+  NotchCoef.b0 = NOTCH_ONE;
+  NotchCoef.b1 = 0;
+  NotchCoef.a1 = 0;
+  NotchCoef.a2 = 0;
+  NotchFreq = 0;
+  notchStage = 0;
+}
+
+/*
+ * Follow the throttle map. Call once per loop; a retune is spread
+ * over the next three calls (cosine lookup, denominator and gain,
+ * numerator) so no frame pays more than one step, and the new
+ * coefficients are switched in together.
+ */
+void notchUpdate(int16_t collective)
+{
+  uint8_t f;
+  int16_t num, den;
+
+  switch(notchStage) {
+  case 0:
+    f = notchMap(collective);
+    if(!f) {
+      NotchFreq = 0;
+      NotchCoef.b0 = NOTCH_ONE;
+      NotchCoef.b1 = 0;
+      NotchCoef.a1 = 0;
+      NotchCoef.a2 = 0;
+    } else if(!NotchFreq || abs(f - NotchFreq) >= NOTCH_HYSTERESIS) {
+      notchTarget = f;
+      notchStage = 1;
+    }
+    break;
+  case 1:
+    notchCos = trigCos(TRIG_ANGLE(notchTarget, ESC_RATE));
+    notchStage = 2;
+    break;
+  case 2:
+    // a1 = -2 r cos(w), a2 = r^2
+    notchNext.a1 = -(((int32_t)NOTCH_R * notchCos) >> 13);
+    notchNext.a2 = ((int32_t)NOTCH_R * NOTCH_R) >> NOTCH_Q;
+
+    // Gain for unity at DC: (1 + a1 + a2) / (2 - 2 cos(w))
+    num = NOTCH_ONE + notchNext.a1 + notchNext.a2;
+    den = (1 << 14) - notchCos;
+    notchNext.b0 = ((int32_t)num << NOTCH_Q) / den;
+    notchStage = 3;
+    break;
+  default:
+    // b1 = -2 cos(w) b0
+    notchNext.b1 = -(((int32_t)notchNext.b0 * notchCos) >> 13);
+    NotchCoef = notchNext;
+    NotchFreq = notchTarget;
+    notchStage = 0;
+    break;
+  }
+}
+#endif
@@ -0,0 +1,86 @@
+#ifndef NOTCH_H
+#define NOTCH_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Gyro notch filter that follows motor noise. The centre frequency
+ * comes from a throttle map in Config (NotchFreq[], Hz at collective
+ * 0, 256, 512, 768 and 1024); a map point of 0 turns the notch off
+ * there. Use the SPECTRUM mode to find the peaks.
+ *
+ * The gyro is sampled once per output frame, so the notch works on
+ * the noise as aliased to below ESC_RATE / 2.
+ */
+#ifndef MINIMAL
+#define GYRO_NOTCH
+#endif
+
+#define NOTCH_POINTS 5
+#define NOTCH_SHIFT 8                // Collective per map segment, bits
+#define NOTCH_FREQ_DEFAULT 0         // Off
+
+#define NOTCH_F_MIN 30               // Hz
+#define NOTCH_F_MAX (ESC_RATE / 2 - 10)
+
+// Retune only when the target moves this far (Hz)
+#define NOTCH_HYSTERESIS 2
+
+/*
+ * Coefficients are Q13. Pole radius r sets the width, about
+ * (1 - r) * ESC_RATE / pi: 0.9 gives ~14Hz at 450Hz.
+ */
+#define NOTCH_Q 13
+#define NOTCH_ONE (1 << NOTCH_Q)
+#define NOTCH_R 7373                 // 0.9
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+/*
+ * (b0 + b1 z^-1 + b0 z^-2) / (1 + a1 z^-1 + a2 z^-2), unity gain
+ * at DC.
+ */
+struct notchCoef {
+  int16_t b0, b1, a1, a2;
+};
+
+struct notchState {
+  int16_t x1, x2, y1, y2;
+};
+/*** END TYPES ***/
+
+/*** BEGIN VARIABLES ***/
+extern struct notchCoef NotchCoef;
+extern struct notchState NotchState[3];
+extern uint8_t NotchFreq;            // Current centre, 0 = bypass
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void notchReset(void);
+void notchUpdate(int16_t collective);
+/*** END PROTOTYPES ***/
+
+/*
+ * One biquad step. In bypass the coefficients are a pass-through, so
+ * the cost is the same and the state stays current.
+ */
+static inline int16_t notchApply(uint8_t axis, int16_t x)
+{
+  struct notchState *s = &NotchState[axis];
+  int16_t y;
+
+  y = ((int32_t)NotchCoef.b0 * (x + s->x2) +
+    (int32_t)NotchCoef.b1 * s->x1 -
+    (int32_t)NotchCoef.a1 * s->y1 -
+    (int32_t)NotchCoef.a2 * s->y2) >> NOTCH_Q;
+
+  s->x2 = s->x1;
+  s->x1 = x;
+  s->y2 = s->y1;
+  s->y1 = y;
+
+  return y;
+}
+
+#endif
@@ -1,5 +1,11 @@
 #include "receiver.h"
 
+#include "latency.h"
+#include "motors.h"
+#include "serialrx.h"
+#include "settings.h"
+#include "timers.h"
+
 /*** BEGIN VARIABLES ***/
 int16_t RxInRoll;
 int16_t RxInPitch;
@@ -16,18 +22,106 @@ uint16_t RxChannel2;
 uint16_t RxChannel3;
 uint16_t RxChannel4;
 
-#ifdef TWIN_COPTER
 int16_t RxInOrgPitch;
+
+bool RxFailsafe;                   // No valid frame within RX_FAILSAFE_US
+uint16_t RxFailsafeCount;          // Failsafe entries
+uint16_t RxGlitchCount;            // Out-of-range pulses dropped
+uint16_t RxRetries;                // Snapshot re-reads forced by interrupts
+uint8_t RxRetryMax;                // Most re-reads in one snapshot
+
+static struct rxChannelState rxChannel[RX_CHANNELS];
+#ifdef RX_SMOOTHER
+static struct rxSmoother rxSmoother[RX_CHANNELS];
+#endif
+
+static struct rxScale rxScale[RX_CHANNELS];
+
+static uint16_t rxClock;           // timer1 time the ages are counted to
+#if RX_MODE != RX_PWM
+static uint16_t rxFrameTime;       // SerialRxFrameTime of the snapshot
+#endif
+
+#if RX_AUX_CHANNELS > 0
+int16_t RxInAux[RX_AUX_CHANNELS];
+#endif
+
+#if RX_AUX_PINS > 0
+uint16_t RxAuxChannel[RX_AUX_PINS];
+uint16_t RxIsrTicksMax;            // Longest dispatcher run, timer1 ticks
+
+static uint16_t rxAuxStart[RX_AUX_PINS];
+static uint8_t rxPortD;            // Port state at the last pin change
+#if RX_AUX_PINS > 2
+static uint8_t rxPortB;
+#endif
 #endif
 /*** END VARIABLES ***/
 
 /*** BEGIN RECEIVER INTERRUPTS ***/
+#if RX_MODE == RX_PWM && !defined(HOST)
 /*
  * Rx interrupts with inline assembler that makes them much faster.
  * Please verify that GCC does not inject anything crazy in here,
  * such as completely unused movs that clobber other registers.
+ *
+ * The host build has no Rx pins; its tests model these in C.
+ */
+
+#if RX_AUX_PINS > 0
+/*
+ * Shared pin-change dispatcher for ports with more than one Rx pin.
+ *
+ * The timer is sampled first so every edge in this interrupt gets the
+ * same timestamp. XOR with the previous port state finds the pins that
+ * changed; each is a fixed test, so the handler time is bounded by the
+ * number of pins on the port whether one or all of them moved. The
+ * time from the timestamp to the end of the handler is tracked in
+ * RxIsrTicksMax (add the fixed prologue/epilogue from the listing).
+ *
+ * Clearing i_sreg forces RxGetChannels() to retry, as with the naked
+ * handlers; here it is also needed on rising edges because the aux
+ * start times live in RAM.
  */
+static inline void rxAuxEdge(uint8_t pins, uint8_t changed, uint8_t bit,
+  uint16_t now, uint8_t aux)
+{
+  if(changed & bit) {
+    if(pins & bit)
+      rxAuxStart[aux] = now;
+    else
+      RxAuxChannel[aux] = now - rxAuxStart[aux];
+  }
+}
 
+static inline void rxIsrTime(uint16_t now)
+{
+  now = TCNT1 - now;
+  if(now > RxIsrTicksMax)
+    RxIsrTicksMax = now;
+}
+
+ISR(PCINT2_vect)
+{
+  uint16_t now = TCNT1;
+  uint8_t pins = PIND;
+  uint8_t changed = pins ^ rxPortD;
+
+  rxPortD = pins;
+  i_sreg = 0;
+  if(changed & _BV(RX_ROLL_BIT)) {
+    if(pins & _BV(RX_ROLL_BIT))
+      RxChannel1Start = now;
+    else
+      RxChannel1 = now - RxChannel1Start;
+  }
+  rxAuxEdge(pins, changed, _BV(RX_AUX1_BIT), now, 0);
+#if RX_AUX_PINS > 1
+  rxAuxEdge(pins, changed, _BV(RX_AUX2_BIT), now, 1);
+#endif
+  rxIsrTime(now);
+}
+#else
 ISR(PCINT2_vect, ISR_NAKED)
 {
   if(RX_ROLL) {        // rising
@@ -48,6 +142,7 @@ ISR(PCINT2_vect, ISR_NAKED)
   }
   asm volatile ("reti");
 }
+#endif
 
 ISR(INT0_vect, ISR_NAKED)
 {
@@ -91,6 +186,28 @@ ISR(INT1_vect, ISR_NAKED)
   asm volatile ("reti");
 }
 
+#if RX_AUX_PINS > 2
+ISR(PCINT0_vect)
+{
+  uint16_t now = TCNT1;
+  uint8_t pins = PINB;
+  uint8_t changed = pins ^ rxPortB;
+
+  rxPortB = pins;
+  i_sreg = 0;
+  if(changed & _BV(RX_YAW_BIT)) {
+    if(pins & _BV(RX_YAW_BIT))
+      RxChannel4Start = now;
+    else
+      RxChannel4 = now - RxChannel4Start;
+  }
+  rxAuxEdge(pins, changed, _BV(RX_AUX3_BIT), now, 2);
+#if RX_AUX_PINS > 3
+  rxAuxEdge(pins, changed, _BV(RX_AUX4_BIT), now, 3);
+#endif
+  rxIsrTime(now);
+}
+#else
 ISR(PCINT0_vect, ISR_NAKED)
 {
   if(RX_YAW) {        // rising
@@ -111,11 +228,20 @@ ISR(PCINT0_vect, ISR_NAKED)
   }
   asm volatile ("reti");
 }
+#endif
+#endif
 /*** END RECEIVER INTERRUPTS ***/
 
 
 void receiverSetup()
 {
+  /*
+   * timer1 (16bit) - run at 8MHz, used to measure Rx pulses
+   * and to control ESC/servo pulse
+   */
+  TCCR1B = _BV(CS10);
+
+#if RX_MODE == RX_PWM
   RX_ROLL_DIR   = INPUT;
   RX_PITCH_DIR  = INPUT;
   RX_COLL_DIR   = INPUT;
@@ -125,12 +251,6 @@ void receiverSetup()
   RX_PITCH  = 0;
   RX_COLL   = 0;
   RX_YAW    = 0;
-  
-  /*
-   * timer1 (16bit) - run at 8MHz, used to measure Rx pulses
-   * and to control ESC/servo pulse
-   */
-  TCCR1B = _BV(CS10);
 
   /*
    * Enable Rx pin interrupts
@@ -138,20 +258,162 @@ void receiverSetup()
   PCICR = _BV(PCIE0) | _BV(PCIE2);  // PCINT0..7, PCINT16..23 enable
   PCMSK0 = _BV(PCINT7);      // PB7
   PCMSK2 = _BV(PCINT17);      // PD1
+#if RX_AUX_PINS > 0
+  RX_AUX1_DIR = INPUT;
+  PCMSK2|= _BV(PCINT20);     // PD4
+#if RX_AUX_PINS > 1
+  RX_AUX2_DIR = INPUT;
+  PCMSK2|= _BV(PCINT16);     // PD0
+#endif
+#if RX_AUX_PINS > 2
+  RX_AUX3_DIR = INPUT;
+  PCMSK0|= _BV(PCINT3);      // PB3
+  rxPortB = PINB;
+#endif
+#if RX_AUX_PINS > 3
+  RX_AUX4_DIR = INPUT;
+  PCMSK0|= _BV(PCINT4);      // PB4
+#endif
+  rxPortD = PIND;
+#endif
   EICRA = _BV(ISC00) | _BV(ISC10);  // Any change INT0, INT1
   EIMSK = _BV(INT0) | _BV(INT1);    // External Interrupt Mask Register
+#else
+  serialRxSetup();
+#endif
+
+  /*
+   * Start in failsafe until every channel has seen a valid frame
+   */
+  for(uint8_t i = 0;i < RX_CHANNELS;i++)
+    rxChannel[i].age = RX_AGE_MAX;
+}
+
+/*
+ * Q16 factor mapping a throw of the given number of ticks to 1000.
+ * Throws shorter than 1000 ticks (125us) would not fit; the
+ * calibration rejects those.
+ */
+static uint16_t rxScaleFactor(uint16_t throw)
+{
+  if(throw <= 1000)
+    return 0xffff;
+  return (1000UL << 16) / throw;
+}
+
+/*
+ * Precompute the per-channel scale factors from the calibrated
+ * endpoints in Config. Sticks map min/center/max to -1000/0/1000,
+ * collective maps min/max to 0/1000. Nonsense calibrations fall back
+ * to the defaults.
+ */
+void receiverBuildScales()
+{
+  uint16_t lo, mid, hi;
+
+  for(uint8_t i = 0;i < RX_CHANNELS;i++) {
+    lo = Config.RxMin[i];
+    mid = Config.RxCenter[i];
+    hi = Config.RxMax[i];
+    if(i == RX_CHANNEL_COLLECTIVE)
+      mid = lo;
+    if(lo < RX_PULSE_MIN || hi > RX_PULSE_MAX || lo > mid || mid > hi ||
+        hi - lo < RX_CAL_MIN_THROW) {
+      lo = RX_DEFAULT_MIN;
+      mid = RX_DEFAULT_CENTER;
+      hi = RX_DEFAULT_MAX;
+      if(i == RX_CHANNEL_COLLECTIVE) {
+        lo = mid = RX_DEFAULT_THROTTLE_MIN;
+        hi = RX_DEFAULT_THROTTLE_MAX;
+      }
+    }
+
+    rxScale[i].center = mid;
+    if(i == RX_CHANNEL_COLLECTIVE) {
+      rxScale[i].neg = rxScaleFactor(hi - lo);
+      rxScale[i].pos = rxScale[i].neg;
+    } else {
+      rxScale[i].neg = rxScaleFactor(mid - lo);
+      rxScale[i].pos = rxScaleFactor(hi - mid);
+    }
+  }
+}
+
+/*
+ * Take a validated pulse width into a channel. With RX_MEDIAN_FILTER,
+ * the channel value is the median of the last three pulses, so a
+ * single glitched (but in-range) pulse never reaches the mixer.
+ */
+static void rxAccept(struct rxChannelState *c, uint16_t width)
+{
+#ifdef RX_MEDIAN_FILTER
+  uint16_t a, b, tmp;
 
+  // Reseed after signal loss so stale history cannot win the vote
+  if(c->age > RX_FAILSAFE_US) {
+    c->history[0] = width;
+    c->history[1] = width;
+  }
+
+  a = c->history[0];
+  b = c->history[1];
+  c->history[1] = a;
+  c->history[0] = width;
+  if(a > b) {
+    tmp = a;
+    a = b;
+    b = tmp;
+  }
+  // The median of three is the newest value clamped to the other two
+  if(width < a)
+    width = a;
+  else if(width > b)
+    width = b;
+#endif
+  c->width = width;
 }
 
+#ifdef RX_SMOOTHER
 /*
- * This adding 7 business is to emulate exactly a signed
- * divide at the zero point (-7 through 7 will become 0).
+ * Setpoint smoothing. Rx frames arrive every ~20ms but we run at
+ * ESC_RATE, so the raw sticks are a staircase. When a new frame
+ * arrives, ramp from the current value to the new one over
+ * Config.RxSmoothing eighths of the measured frame interval (in
+ * loops). 0 disables smoothing, 8 gives a straight-line interpolation
+ * at the cost of one frame of added latency.
+ *
+ * The division happens once per frame; each loop is an add.
  */
-int16_t fastdiv8(int16_t x) {
-  if(x < 0)
-    x+= 7;
-  return x >> 3;
+static int16_t rxSmooth(struct rxSmoother *s, int16_t in, uint8_t fresh)
+{
+  uint8_t span;
+
+  if(s->loops < 0xff)
+    s->loops++;
+
+  if(fresh) {
+    span = ((uint16_t)s->loops * Config.RxSmoothing) >> 3;
+    s->loops = 0;
+    if(span > 1) {
+      s->step = ((in << RX_SMOOTH_SHIFT) - s->value) / span;
+      s->left = span;
+    } else {
+      s->left = 0;
+    }
+  }
+
+  if(s->left) {
+    if(--s->left)
+      s->value+= s->step;
+    else
+      s->value = in << RX_SMOOTH_SHIFT;
+  } else {
+    s->value = in << RX_SMOOTH_SHIFT;
+  }
+
+  return s->value >> RX_SMOOTH_SHIFT;
 }
+#endif
 
 /*
  * Copy, scale, and offset the Rx inputs from the interrupt-modified
@@ -166,31 +428,294 @@ int16_t fastdiv8(int16_t x) {
  * reordering it to be unsafe other than by doing the set in inline
  * assembler with a memory barrier.
  */
-void RxGetChannels()
+static inline void rxCountRetries(uint8_t passes)
 {
+  passes--;
+  RxRetries+= passes;
+  if(passes > RxRetryMax)
+    RxRetryMax = passes;
+}
+
+#if RX_MODE == RX_PWM
+/*
+ * Copy the pulse widths and work out which channels have a new frame:
+ * a channel has one when its pulse started since the last frame we saw
+ * and has since ended.
+ */
+static uint8_t rxSnapshot(uint16_t *width)
+{
+  uint16_t start[RX_CHANNELS];
+  uint8_t low, arrived, i;
   uint8_t t = 0xff;
+  uint8_t passes = 0;
+
   do {
-    asm volatile("mov %0, %1":"=r" (i_sreg),"=r" (t)::"memory");
-    RxInRoll = fastdiv8(RxChannel1 - 1520 * 8);
-    RxInPitch = fastdiv8(RxChannel2 - 1520 * 8);
-    RxInCollective = fastdiv8(RxChannel3 - 1120 * 8);
-    RxInYaw = fastdiv8(RxChannel4 - 1520 * 8);
+    passes++;
+    rxArmRetry(t);
+    /*
+     * Order matters: start times, then pins, then widths. A rising
+     * edge after the start times were read leaves them unchanged,
+     * and a falling edge seen on the pins will have run its
+     * interrupt (and forced a retry) before we finish.
+     */
+    start[0] = rxReadStart(RxChannel1Start);
+    start[1] = rxReadStart(RxChannel2Start);
+    start[2] = rxReadStart(RxChannel3Start);
+    start[3] = rxReadStart(RxChannel4Start);
+#if RX_AUX_PINS > 0
+    for(i = 0;i < RX_AUX_PINS;i++)
+      start[RX_CHANNEL_AUX1 + i] = rxAuxStart[i];
+#endif
+    low = 0;
+    if(!RX_ROLL)
+      low|= _BV(0);
+    if(!RX_PITCH)
+      low|= _BV(1);
+    if(!RX_COLL)
+      low|= _BV(2);
+    if(!RX_YAW)
+      low|= _BV(3);
+#if RX_AUX_PINS > 0
+    if(!RX_AUX1)
+      low|= _BV(RX_CHANNEL_AUX1);
+#endif
+#if RX_AUX_PINS > 1
+    if(!RX_AUX2)
+      low|= _BV(RX_CHANNEL_AUX1 + 1);
+#endif
+#if RX_AUX_PINS > 2
+    if(!RX_AUX3)
+      low|= _BV(RX_CHANNEL_AUX1 + 2);
+#endif
+#if RX_AUX_PINS > 3
+    if(!RX_AUX4)
+      low|= _BV(RX_CHANNEL_AUX1 + 3);
+#endif
+    width[0] = RxChannel1;
+    width[1] = RxChannel2;
+    width[2] = RxChannel3;
+    width[3] = RxChannel4;
+#if RX_AUX_PINS > 0
+    for(i = 0;i < RX_AUX_PINS;i++)
+      width[RX_CHANNEL_AUX1 + i] = RxAuxChannel[i];
+#endif
+  } while(i_sreg != t);
+  rxCountRetries(passes);
+
+  arrived = 0;
+  for(i = 0;i < RX_CHANNELS;i++) {
+    if((low & _BV(i)) && start[i] != rxChannel[i].lastStart) {
+      rxChannel[i].lastStart = start[i];
+      arrived|= _BV(i);
+    }
+  }
+
+  return arrived;
+}
+#else
+/*
+ * Copy the channels of the last complete serial frame. All channels
+ * are new together when the frame counter has moved.
+ */
+static uint8_t rxSnapshot(uint16_t *width)
+{
+  static uint8_t lastFrame;
+  uint8_t frame, i;
+  uint8_t t = 0xff;
+  uint8_t passes = 0;
+
+  do {
+    passes++;
+    rxArmRetry(t);
+    frame = SerialRxFrames;
+    rxFrameTime = SerialRxFrameTime;
+    for(i = 0;i < RX_CHANNELS;i++)
+      width[i] = serialRxWidth(i);
   } while(i_sreg != t);
-#ifdef TWIN_COPTER
-  RxInOrgPitch = RxInPitch;
+  rxCountRetries(passes);
+
+  if(frame == lastFrame)
+    return 0;
+  lastFrame = frame;
+  return (uint8_t)((1 << RX_CHANNELS) - 1);
+}
+#endif
+
+/*
+ * When the last value of a channel was captured: the falling edge
+ * of its pulse, or the end of the serial frame.
+ */
+static inline uint16_t rxCaptureTime(uint8_t i, uint16_t width)
+{
+#if RX_MODE == RX_PWM
+  return rxChannel[i].lastStart + width;
+#else
+  return rxFrameTime;
 #endif
 }
 
-void receiverStickCenter()
+/*
+ * Age a channel: since its capture when it has a new one, otherwise
+ * by the `elapsed` us since the last call.
+ */
+static inline void rxAge(struct rxChannelState *c, uint16_t capture,
+  uint16_t now, uint16_t elapsed, bool fresh)
+{
+  if(fresh)
+    c->age = (uint16_t)(now - capture) >> 3;
+  else if(c->age > RX_AGE_MAX - elapsed)
+    c->age = RX_AGE_MAX;
+  else
+    c->age+= elapsed;
+}
+
+void RxGetChannels()
+{
+  uint16_t width[RX_CHANNELS];
+  int16_t in[RX_CHANNELS];
+  uint16_t now, elapsed;
+  uint8_t arrived, fresh, stale, i;
+
+  arrived = rxSnapshot(width);
+
+  cli();
+  now = TCNT1;
+  sei();
+  elapsed = (uint16_t)(now - rxClock) >> 3;
+  rxClock+= elapsed << 3;    // Keep the fraction for the next call
+
+  fresh = 0;
+  stale = 0;
+  for(i = 0;i < RX_CHANNELS;i++) {
+    /*
+     * Pulses outside the valid range are counted and dropped, so the
+     * channel keeps its last good value and keeps ageing.
+     */
+    if(arrived & _BV(i)) {
+      if(width[i] < RX_PULSE_MIN || width[i] > RX_PULSE_MAX) {
+        RxGlitchCount++;
+      } else {
+        rxAccept(&rxChannel[i], width[i]);
+        fresh|= _BV(i);
+      }
+    }
+
+    rxAge(&rxChannel[i], rxCaptureTime(i, width[i]), now, elapsed, fresh & _BV(i));
+
+    in[i] = rxNormalize(&rxScale[i], rxChannel[i].width);
+#ifdef RX_SMOOTHER
+    in[i] = rxSmooth(&rxSmoother[i], in[i], fresh & _BV(i));
+#endif
+
+    if(rxChannel[i].age > RX_FAILSAFE_US) {
+      if(i < RX_CHANNEL_AUX1)
+        stale = 1;
+      else
+        in[i] = RX_FAILSAFE_AUX;
+    }
+  }
+
+  if(stale) {
+    if(!RxFailsafe)
+      RxFailsafeCount++;
+    RxFailsafe = true;
+    in[0] = RX_FAILSAFE_ROLL;
+    in[1] = RX_FAILSAFE_PITCH;
+    in[2] = RX_FAILSAFE_COLLECTIVE;
+    in[3] = RX_FAILSAFE_YAW;
+#if RX_AUX_CHANNELS > 0
+    for(i = 0;i < RX_AUX_CHANNELS;i++)
+      in[RX_CHANNEL_AUX1 + i] = RX_FAILSAFE_AUX;
+#endif
+  } else {
+    RxFailsafe = false;
+#ifdef LATENCY_TRACE
+    for(i = 0;i < LATENCY_CHANNELS;i++) {
+      if(fresh & _BV(i))
+        latencyCapture(i, rxCaptureTime(i, width[i]));
+    }
+#endif
+  }
+
+  RxInRoll = in[0];
+  RxInPitch = in[1];
+  RxInCollective = in[2];
+  RxInYaw = in[3];
+#if RX_AUX_CHANNELS > 0
+  for(i = 0;i < RX_AUX_CHANNELS;i++)
+    RxInAux[i] = in[RX_CHANNEL_AUX1 + i];
+#endif
+  RxInOrgPitch = RxInPitch >> 1;
+}
+
+/*
+ * Receiver calibration mode.
+ *
+ * Move all sticks (and throttle) to their extremes; the LED flickers
+ * while new endpoints are being found. Then release the sticks to
+ * center with throttle low. When the sticks have been still for
+ * RX_CAL_SETTLE_MS after all channels have seen a full throw, the
+ * centers are recorded, the calibration is saved and the LED stays on.
+ */
+void receiverCalibrate()
 {
-  uint8_t i;
+  uint16_t lo[RX_CHANNELS], hi[RX_CHANNELS], last[RX_CHANNELS];
+  uint16_t w;
+  uint8_t i, moving, full;
+
+  for(i = 0;i < RX_CHANNELS;i++) {
+    lo[i] = 0xffff;
+    hi[i] = 0;
+    last[i] = 0;
+  }
+  /*
+   * One output frame per pass keeps the ESCs fed and paces the loop
+   * to ESC_RATE. While there is no signal, the settle time starts
+   * over: the sticks have not been seen still.
+   */
   while(1) {
+    motorsStopFrame();
     RxGetChannels();
-    i = abs(RxInRoll) + abs(RxInPitch) + abs(RxInYaw);
-    LED = 1;
-    while(i) {
-      LED = 0;
-      i--;
+    if(RxFailsafe) {
+      timersStart(TIMER_MODE, TIMER_MS(RX_CAL_SETTLE_MS), 0);
+      continue;
+    }
+
+    moving = 0;
+    full = 1;
+    for(i = 0;i < RX_CHANNELS;i++) {
+      w = rxChannel[i].width;
+      if(w < lo[i]) {
+        lo[i] = w;
+        moving = 1;
+      }
+      if(w > hi[i]) {
+        hi[i] = w;
+        moving = 1;
+      }
+      if(hi[i] - lo[i] < RX_CAL_MIN_THROW)
+        full = 0;
+      if(abs((int16_t)(w - last[i])) > RX_CAL_STILL)
+        moving = 1;
+      last[i] = w;
     }
+    LED = moving;
+
+    if(moving || !full)
+      timersStart(TIMER_MODE, TIMER_MS(RX_CAL_SETTLE_MS), 0);
+    else if(timersFired(TIMER_MODE))
+      break;
+  }
+
+  for(i = 0;i < RX_CHANNELS;i++) {
+    Config.RxMin[i] = lo[i];
+    Config.RxCenter[i] = last[i];
+    Config.RxMax[i] = hi[i];
   }
-}
\ No newline at end of file
+  Save_Config_to_EEPROM();
+  receiverBuildScales();
+
+  LED = 1;
+  while(1)
+    motorsStopFrame();
+}
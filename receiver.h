@@ -5,17 +5,156 @@
 
 /*** BEGIN DEFINES ***/
 // Stick arming and throw detection (in % * 10 eg 1000 steps)
-#define STICK_THROW 300
+#define STICK_THROW 600
 
-// Stick gain shift-right (after 32-bit multiplication of GainInADC[] value).
-#define STICK_GAIN_SHIFT 8
+// Stick gain shift-right (after 32-bit multiplication of GainPotADC[] value).
+#define STICK_GAIN_SHIFT 9
 
 // Max Collective
 // limits the maximum stick collective (range 80->100  100=Off)
 // this allows gyros to stabilise better when full throttle applied
 #define MAX_COLLECTIVE 1000      // 95
+
+/*
+ * Receiver type: one PWM pulse per channel on the Rx pins, or a
+ * serial receiver on the UART RXD pin (PD0, see serialrx.h).
+ */
+#define RX_PWM 0
+#define RX_SBUS 1
+#define RX_SPEKTRUM 2
+#ifndef RX_MODE
+#define RX_MODE RX_PWM
+#endif
+
+/*
+ * Auxiliary channels (0-4) for switches, decoded on spare pins (see
+ * io_cfg.h). Aux 1-2 share the roll pin-change interrupt, aux 3-4
+ * the yaw one; those interrupts then go through a C dispatcher
+ * instead of the naked single-channel handlers. Serial receivers
+ * carry the aux channels in the frame and use no extra pins.
+ */
+#ifndef RX_AUX_CHANNELS
+#define RX_AUX_CHANNELS 0
+#endif
+
+#define RX_CHANNELS (4 + RX_AUX_CHANNELS)
+#define RX_CHANNEL_COLLECTIVE 2
+#define RX_CHANNEL_AUX1 4
+
+// Uncalibrated endpoints (in timer1 ticks)
+#define RX_DEFAULT_MIN (1020 * 8)
+#define RX_DEFAULT_CENTER (1520 * 8)
+#define RX_DEFAULT_MAX (2020 * 8)
+#define RX_DEFAULT_THROTTLE_MIN (1120 * 8)
+#define RX_DEFAULT_THROTTLE_MAX (1920 * 8)
+
+// Calibration: minimum accepted throw, stillness window, settle time
+#define RX_CAL_MIN_THROW (400 * 8)
+#define RX_CAL_STILL (10 * 8)
+#define RX_CAL_SETTLE_MS 1000
+
+// Valid pulse widths (in timer1 ticks); anything else is a glitch
+#define RX_PULSE_MIN (800 * 8)
+#define RX_PULSE_MAX (2200 * 8)
+
+// Median-of-three filter against single-pulse glitches (not MINIMAL)
+#ifndef MINIMAL
+#define RX_MEDIAN_FILTER
+#endif
+
+/*
+ * Failsafe triggers when the last valid capture of any of the four
+ * primary channels is more than RX_FAILSAFE_US old (1.5 frame periods
+ * of a 50Hz receiver), going by its timer1 timestamp: the falling
+ * edge of a PWM pulse, or the last byte of a serial frame. The RxIn
+ * values are then replaced by the RX_FAILSAFE_* outputs. An aux
+ * channel as old on its own (an unplugged switch lead) reads
+ * RX_FAILSAFE_AUX, and the link stays up.
+ *
+ * Ages are kept in microseconds, advanced by the timer1 time between
+ * RxGetChannels() calls, so they do not depend on how often it is
+ * called; timer1 wraps every 8.2ms, so a caller that stalls for
+ * longer than that (arming) delays detection by the missed wraps.
+ */
+#define RX_FAILSAFE_US 30000
+#define RX_FAILSAFE_ROLL 0
+#define RX_FAILSAFE_PITCH 0
+#define RX_FAILSAFE_COLLECTIVE 0
+#define RX_FAILSAFE_YAW 0
+#define RX_FAILSAFE_AUX 0
+
+// Setpoint smoothing span (in eighths of a frame interval, 0 = off)
+#define RX_SMOOTHING_DEFAULT 4
+
+// Setpoint smoothing itself (not MINIMAL, which ignores the span)
+#ifndef MINIMAL
+#define RX_SMOOTHER
+#endif
+
+// Fractional bits of the smoothed setpoints
+#define RX_SMOOTH_SHIFT 2
 /*** END DEFINES ***/
 
+#if RX_AUX_CHANNELS > 4
+#error At most 4 auxiliary Rx channels are supported
+#endif
+
+#if RX_MODE == RX_PWM
+#define RX_AUX_PINS RX_AUX_CHANNELS
+#else
+#define RX_AUX_PINS 0
+#endif
+
+/*** BEGIN HELPER MACROS ***/
+#define RX_AGE_MAX 0xffff          // us, ages saturate here
+
+/*
+ * Read one of the pinned ISR start registers. Plain C reads of global
+ * register variables may be hoisted out of the RxGetChannels() retry
+ * loop, as the compiler does not know that interrupts change them.
+ *
+ * rxArmRetry() starts a pass of a retry loop: i_sreg = t, which any
+ * interrupt that changes the state overwrites (see RxGetChannels()).
+ *
+ * The host build (test/) has plain volatile variables instead.
+ */
+#ifndef HOST
+#define rxReadStart(r) ({ \
+  uint16_t _v; \
+  asm volatile("movw %0, %1" : "=r" (_v) : "r" (r)); \
+  _v; \
+})
+#define rxArmRetry(t) asm volatile("mov %0, %1":"=r" (i_sreg),"=r" (t)::"memory")
+#else
+#define rxReadStart(r) (r)
+#define rxArmRetry(t) do { i_sreg = (t); asm volatile("":::"memory"); } while(0)
+#endif
+/*** END HELPER MACROS ***/
+
+/*** BEGIN TYPES ***/
+struct rxScale {
+  uint16_t center;                   // Pulse width of 0 output
+  uint16_t neg;                      // Q16 scale below center
+  uint16_t pos;                      // Q16 scale above center
+};
+
+struct rxChannelState {
+  uint16_t lastStart;                // Pulse start time of the last frame
+  uint16_t width;                    // Accepted pulse width
+#ifdef RX_MEDIAN_FILTER
+  uint16_t history[2];               // Last two valid pulse widths
+#endif
+  uint16_t age;                      // us since the last valid capture
+};
+
+struct rxSmoother {
+  int16_t value;                     // Current setpoint << RX_SMOOTH_SHIFT
+  int16_t step;                      // Per-loop ramp increment
+  uint8_t left;                      // Loops left in the ramp
+  uint8_t loops;                     // Loops since the last frame
+};
+/*** END TYPES ***/
+
 
 /*** BEGIN VARIABLES ***/
 extern int16_t RxInRoll;
@@ -28,28 +167,77 @@ extern uint16_t RxChannel2;
 extern uint16_t RxChannel3;
 extern uint16_t RxChannel4;
 
+/*
+ * Interrupt state lives in fixed registers. The Makefile builds every
+ * file with -ffixed-r2..r12, so code that does not include this
+ * header cannot use them either; "make regcheck" lists what does.
+ */
+#ifndef HOST
 register uint16_t i_tmp asm("r2");               // ISR vars
 register uint16_t RxChannel1Start asm("r4");
 register uint16_t RxChannel2Start asm("r6");
 register uint16_t RxChannel3Start asm("r8");
 register uint16_t RxChannel4Start asm("r10");
 register uint8_t i_sreg asm("r12");
+#else
+extern volatile uint16_t i_tmp;
+extern volatile uint16_t RxChannel1Start;
+extern volatile uint16_t RxChannel2Start;
+extern volatile uint16_t RxChannel3Start;
+extern volatile uint16_t RxChannel4Start;
+extern volatile uint8_t i_sreg;
+#endif
 
-#ifdef TWIN_COPTER
 extern int16_t RxInOrgPitch;
+
+#if RX_AUX_CHANNELS > 0
+extern int16_t RxInAux[RX_AUX_CHANNELS];
+#endif
+#if RX_AUX_PINS > 0
+extern uint16_t RxAuxChannel[RX_AUX_PINS];
+extern uint16_t RxIsrTicksMax;
 #endif
+
+extern bool RxFailsafe;
+extern uint16_t RxFailsafeCount;
+extern uint16_t RxGlitchCount;
+extern uint16_t RxRetries;
+extern uint8_t RxRetryMax;
 /*** END VARIABLES ***/
 
 /*** BEGIN PROTOTYPES ***/
+#if RX_MODE == RX_PWM && !defined(HOST)
+#if RX_AUX_PINS > 0
+ISR(PCINT2_vect);
+#else
 ISR(PCINT2_vect, ISR_NAKED);
+#endif
 ISR(INT0_vect, ISR_NAKED);
 ISR(INT1_vect, ISR_NAKED);
+#if RX_AUX_PINS > 2
+ISR(PCINT0_vect);
+#else
 ISR(PCINT0_vect, ISR_NAKED);
+#endif
+#endif
 
 void receiverSetup(void);
-int16_t fastdiv8(int16_t x);
+void receiverBuildScales(void);
 void RxGetChannels(void);
-void receiverStickCenter(void);
+void receiverCalibrate(void);
 /*** END PROTOTYPES ***/
 
+/*
+ * Map a pulse width to -1000..1000 (or 0..1000 for collective) with
+ * the precomputed scale factors: one subtract and one multiply.
+ */
+static inline int16_t rxNormalize(const struct rxScale *s, uint16_t width)
+{
+  int16_t d = width - s->center;
+
+  if(d < 0)
+    return -(int16_t)(((uint32_t)(uint16_t)-d * s->neg) >> 16);
+  return ((uint32_t)(uint16_t)d * s->pos) >> 16;
+}
+
 #endif
\ No newline at end of file
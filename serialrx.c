@@ -0,0 +1,166 @@
+#include "serialrx.h"
+
+#include "receiver.h"
+
+#if RX_MODE != RX_PWM
+
+/*** BEGIN VARIABLES ***/
+uint16_t SerialRxChannel[2][SERIALRX_CHANNELS];
+uint8_t SerialRxFront;
+uint8_t SerialRxFrames;
+uint16_t SerialRxErrors;
+uint16_t SerialRxLost;
+uint16_t SerialRxFrameTime;
+
+static uint8_t serialRxIndex;        // Byte position in the current frame
+static uint16_t serialRxLastByte;    // Arrival time of the last byte
+#if RX_MODE == RX_SBUS
+static uint32_t serialRxBits;        // Channel bit accumulator
+static uint8_t serialRxBitCount;
+static uint8_t serialRxChannel;
+static const uint8_t serialRxMap[] = SBUS_CHANNEL_MAP;
+#else
+static uint8_t serialRxHigh;         // First byte of a channel word
+static const uint8_t serialRxMap[] = SPEKTRUM_CHANNEL_MAP;
+#endif
+/*** END VARIABLES ***/
+
+void serialRxSetup()
+{
+#if RX_MODE == RX_SBUS
+  UBRR0 = (F_CPU / 16 + SBUS_BAUD / 2) / SBUS_BAUD - 1;
+  UCSR0A = 0;
+  UCSR0C = _BV(UPM01) | _BV(USBS0) | _BV(UCSZ01) | _BV(UCSZ00);  // 8E2
+#else
+  UBRR0 = (F_CPU / 8 + SPEKTRUM_BAUD / 2) / SPEKTRUM_BAUD - 1;
+  UCSR0A = _BV(U2X0);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);  // 8N1
+#endif
+  UCSR0B|= _BV(RXEN0) | _BV(RXCIE0);
+}
+
+/*
+ * Publish the back buffer. Clearing i_sreg makes a concurrent
+ * RxGetChannels() copy retry, as the Rx pin interrupts do.
+ *
+ * Spektrum satellites with more channels than fit a frame send them
+ * over two frames, so a frame only updates some of the back buffer:
+ * start the new one from the frame just published, or the channels
+ * the next frame does not carry would go back to older values.
+ */
+static inline void serialRxFlip(void)
+{
+  SerialRxFront^= 1;
+  SerialRxFrames++;
+  SerialRxFrameTime = serialRxLastByte;
+  i_sreg = 0;
+#if RX_MODE == RX_SPEKTRUM
+  for(uint8_t i = 0;i < sizeof(serialRxMap);i++) {
+    uint8_t c = serialRxMap[i];
+
+    SerialRxChannel[SerialRxFront ^ 1][c] = SerialRxChannel[SerialRxFront][c];
+  }
+#endif
+}
+
+/*
+ * Decode one byte at a time into the back buffer. A gap of more than
+ * SERIALRX_GAP or a receive error restarts frame sync.
+ */
+ISR(USART_RX_vect)
+{
+  uint16_t now = TCNT1;
+  uint8_t status = UCSR0A;
+  uint8_t b = UDR0;
+  uint16_t *back = SerialRxChannel[SerialRxFront ^ 1];
+
+  if((uint16_t)(now - serialRxLastByte) > SERIALRX_GAP)
+    serialRxIndex = 0;
+  serialRxLastByte = now;
+
+  if(status & (_BV(FE0) | _BV(DOR0) | _BV(UPE0))) {
+    SerialRxErrors++;
+    serialRxIndex = 0xff;            // Wait for the next gap
+    return;
+  }
+  if(serialRxIndex == 0xff)
+    return;
+
+#if RX_MODE == RX_SBUS
+  if(serialRxIndex == 0) {
+    if(b != SBUS_START_BYTE) {
+      SerialRxErrors++;
+      serialRxIndex = 0xff;
+      return;
+    }
+    serialRxBits = 0;
+    serialRxBitCount = 0;
+    serialRxChannel = 0;
+  } else if(serialRxIndex <= 22) {
+    serialRxBits|= (uint32_t)b << serialRxBitCount;
+    serialRxBitCount+= 8;
+    if(serialRxBitCount >= 11) {
+      back[serialRxChannel++] = serialRxBits & 0x7ff;
+      serialRxBits>>= 11;
+      serialRxBitCount-= 11;
+    }
+  } else if(serialRxIndex == 23) {
+    if(b & (SBUS_FLAG_FRAME_LOST | SBUS_FLAG_FAILSAFE)) {
+      SerialRxLost++;
+      serialRxIndex = 0xff;
+      return;
+    }
+  } else {
+    serialRxFlip();
+    serialRxIndex = 0xff;
+    return;
+  }
+#else
+  /*
+   * Bytes 0-1 are fades and system; then 7 big-endian words of
+   * channel id and value. Unused words are 0xffff.
+   */
+  if(serialRxIndex >= 2) {
+    if(!(serialRxIndex & 1)) {
+      serialRxHigh = b;
+    } else if(serialRxHigh != 0xff) {
+      uint16_t w = ((uint16_t)serialRxHigh << 8) | b;
+#ifdef SPEKTRUM_11BIT
+      uint8_t id = (w >> 11) & 0x0f;
+      w&= 0x7ff;
+#else
+      uint8_t id = (w >> 10) & 0x0f;
+      w&= 0x3ff;
+#endif
+      if(id < SERIALRX_CHANNELS)
+        back[id] = w;
+    }
+    if(serialRxIndex == SPEKTRUM_FRAME_SIZE - 1) {
+      serialRxFlip();
+      serialRxIndex = 0xff;
+      return;
+    }
+  }
+#endif
+  serialRxIndex++;
+}
+
+/*
+ * Raw value of one of our channels from the front buffer, converted to
+ * the timer1 ticks (1/8 us) of a PWM pulse of the same position.
+ * Call from inside the RxGetChannels() retry loop.
+ */
+uint16_t serialRxWidth(uint8_t channel)
+{
+  uint16_t v = SerialRxChannel[SerialRxFront][serialRxMap[channel]];
+
+#if RX_MODE == RX_SBUS
+  return v * 5 + 880 * 8;            // 0.625us per step from 880us
+#elif defined(SPEKTRUM_11BIT)
+  return v * 4 + 988 * 8;            // 0.5us per step from 988us
+#else
+  return v * 8 + 988 * 8;            // 1us per step from 988us
+#endif
+}
+
+#endif
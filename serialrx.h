@@ -0,0 +1,56 @@
+#ifndef SERIALRX_H
+#define SERIALRX_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Serial receiver protocols (select with RX_MODE in receiver.h).
+ *
+ * SBUS: 100000 baud 8E2, inverted (needs an inverter on PD0), 25-byte
+ * frames of 16 x 11-bit channels plus flags.
+ *
+ * Spektrum satellite: 115200 baud 8N1, 16-byte frames of 7 channel
+ * words. Define SPEKTRUM_11BIT for 2048-step (DSMX 11ms) satellites.
+ * Note that 115200 baud is 3.5% off at 8MHz; a 16MHz clock is better.
+ */
+//#define SPEKTRUM_11BIT
+
+#define SBUS_BAUD 100000
+#define SBUS_FRAME_SIZE 25
+#define SBUS_START_BYTE 0x0f
+#define SBUS_FLAG_FRAME_LOST _BV(2)
+#define SBUS_FLAG_FAILSAFE _BV(3)
+
+#define SPEKTRUM_BAUD 115200
+#define SPEKTRUM_FRAME_SIZE 16
+
+#define SERIALRX_CHANNELS 16
+
+// Idle time (in timer1 ticks) that marks the start of a new frame
+#define SERIALRX_GAP (500 * 8)
+
+/*
+ * Protocol channel for each of our channels (roll, pitch, collective,
+ * yaw, aux 1-4). SBUS follows the transmitter (AETR here); Spektrum
+ * uses fixed ids (throttle 0, aileron 1, elevator 2, rudder 3, ...).
+ */
+#define SBUS_CHANNEL_MAP { 0, 1, 2, 3, 4, 5, 6, 7 }
+#define SPEKTRUM_CHANNEL_MAP { 1, 2, 0, 3, 4, 5, 6, 7 }
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern uint16_t SerialRxChannel[2][SERIALRX_CHANNELS];  // Raw channel values
+extern uint8_t SerialRxFront;        // Buffer holding the last full frame
+extern uint8_t SerialRxFrames;       // Complete frames received
+extern uint16_t SerialRxErrors;      // Framing/parity/overrun/sync errors
+extern uint16_t SerialRxLost;        // Frames flagged lost or failsafe
+extern uint16_t SerialRxFrameTime;   // Last byte of the last full frame
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void serialRxSetup(void);
+uint16_t serialRxWidth(uint8_t channel);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -2,13 +2,26 @@
 
 #include <avr/eeprom.h>
 #include "gyros.h"
+#include "motors.h"
+#include "receiver.h"
+#include "sticks.h"
+#include "timers.h"
 
 struct config Config;
 
+/*
+ * A write takes 3.4ms, a whole config ~300ms: the ESCs get stopped
+ * frames until it is done, which also resets the watchdog. So this
+ * is only for when the motors are stopped anyway (setup modes, or
+ * disarmed), and after motorsSetup() and sei().
+ */
 void eeprom_write_byte_changed(uint8_t *addr, uint8_t value)
 {
-  if(eeprom_read_byte(addr) != value)
-    eeprom_write_byte(addr, value);
+  if(eeprom_read_byte(addr) == value)
+    return;
+  eeprom_write_byte(addr, value);
+  while(!eeprom_is_ready())
+    motorsStopFrame();
 }
 
 void eeprom_write_block_changes(const uint8_t *src, void *dest, size_t size)
@@ -34,20 +47,63 @@ void Set_EEPROM_Default_Config()
   Config.RollGyroDirection  = GYRO_REVERSED;
   Config.PitchGyroDirection  = GYRO_REVERSED;
   Config.YawGyroDirection    = GYRO_NORMAL;
+
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    Config.StickRate[i] = STICK_RATE_DEFAULT;
+    Config.StickExpo[i] = STICK_EXPO_DEFAULT;
+    for(uint8_t j = 0;j < TPA_POINTS;j++)
+      Config.TpaGain[i][j] = TPA_GAIN_DEFAULT;
+#ifdef AUTOTUNE
+    Config.TunedGain[i] = 0;
+    Config.TunedI[i] = 0;
+    Config.TunedD[i] = 0;
+#endif
+  }
+
+  Config.TpaThrottle[0] = TPA_THROTTLE_DEFAULT_0;
+  Config.TpaThrottle[1] = TPA_THROTTLE_DEFAULT_1;
+  Config.TpaThrottle[2] = TPA_THROTTLE_DEFAULT_2;
+
+  Config.RxSmoothing = RX_SMOOTHING_DEFAULT;
+
+  Config.FrameType = FRAME_DEFAULT;
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS_ALL;i++)
+    Config.OutputRate[i] = 0;
+
+#ifdef GYRO_NOTCH
+  for(uint8_t i = 0;i < NOTCH_POINTS;i++)
+    Config.NotchFreq[i] = NOTCH_FREQ_DEFAULT;
+#endif
+
+  for(uint8_t i = 0;i < RX_CHANNELS;i++) {
+    Config.RxMin[i] = RX_DEFAULT_MIN;
+    Config.RxCenter[i] = RX_DEFAULT_CENTER;
+    Config.RxMax[i] = RX_DEFAULT_MAX;
+  }
+  Config.RxMin[RX_CHANNEL_COLLECTIVE] = RX_DEFAULT_THROTTLE_MIN;
+  Config.RxCenter[RX_CHANNEL_COLLECTIVE] = RX_DEFAULT_THROTTLE_MIN;
+  Config.RxMax[RX_CHANNEL_COLLECTIVE] = RX_DEFAULT_THROTTLE_MAX;
 }
 
 void Initial_EEPROM_Config_Load()
 {
+  const uint8_t *start = (const uint8_t *)EEPROM_DATA_START_POS;
+  uint8_t setup = eeprom_read_byte(start);
+
   // load up last settings from EEPROM
-  if(eeprom_read_byte((uint8_t *)EEPROM_DATA_START_POS) != 42) {
-    Config.setup = 42;
-    Set_EEPROM_Default_Config();
-    // write to eeProm
-    Save_Config_to_EEPROM();
-  } else {
-    // read eeprom
-    eeprom_read_block(&Config, (void *)EEPROM_DATA_START_POS, sizeof(struct config));
+  if(setup == SETTINGS_VERSION &&
+    eeprom_read_byte(start + offsetof(struct config, layout)) == SETTINGS_LAYOUT) {
+    eeprom_read_block(&Config, start, sizeof(struct config));
+    return;
   }
+
+  Set_EEPROM_Default_Config();
+  if(setup == SETTINGS_VERSION)      // Another build profile's
+    eeprom_read_block(&Config, start, SETTINGS_FIXED);
+  Config.setup = SETTINGS_VERSION;
+  Config.layout = SETTINGS_LAYOUT;
+  // write to eeProm; no frames yet, nor the watchdog
+  eeprom_write_block(&Config, (void *)EEPROM_DATA_START_POS, sizeof(struct config));
 }
 
 void settingsSetup()
@@ -57,14 +113,12 @@ void settingsSetup()
 
 void settingsClearAll()
 {
-  for(uint8_t i = 0;i < 5;i++) {
-    LED = 1;
-    _delay_ms(25);
-    LED = 0;
-    _delay_ms(25);
-  }
+  timersFlash(5);
+  while(timersFlashing())
+    motorsStopFrame();
 
   Set_EEPROM_Default_Config();
+  Save_Config_to_EEPROM();
   while(1)
-          ;
+    motorsStopFrame();
 }
\ No newline at end of file
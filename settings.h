@@ -1,19 +1,67 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <stddef.h>
+
 #include "config.h"
+#include "autotune.h"
+#include "receiver.h"
+#include "tpa.h"
+#include "notch.h"
+#include "mixer.h"
 
 /*** BEGIN DEFINITIONS ***/
 #define EEPROM_DATA_START_POS 0      // Settings save offset in eeprom
+#define SETTINGS_VERSION 53          // Bump whenever struct config changes
+
+/*
+ * The fields after SETTINGS_FIXED depend on the build profile; the
+ * profile options that size them make up SETTINGS_LAYOUT, saved along
+ * with the version. Settings saved by another profile keep their
+ * fixed part, the rest goes back to defaults.
+ */
+#ifdef GYRO_NOTCH
+#define SETTINGS_LAYOUT_NOTCH 0x10
+#else
+#define SETTINGS_LAYOUT_NOTCH 0
+#endif
+#ifdef AUTOTUNE
+#define SETTINGS_LAYOUT_AUTOTUNE 0x20
+#else
+#define SETTINGS_LAYOUT_AUTOTUNE 0
+#endif
+#define SETTINGS_LAYOUT (RX_AUX_CHANNELS | SETTINGS_LAYOUT_NOTCH | SETTINGS_LAYOUT_AUTOTUNE)
+#define SETTINGS_FIXED offsetof(struct config, RxMin)
 /*** END DEFINITIONS ***/
 
 /*** BEGIN TYPES ***/
 // eeProm data structure
 struct config {
   uint8_t  setup;                    // Byte to identify if already setup
+  uint8_t layout;                    // SETTINGS_LAYOUT
   uint8_t RollGyroDirection;
   uint8_t PitchGyroDirection;
   uint8_t YawGyroDirection;
+  uint8_t StickRate[3];              // Stick rate in %, per axis
+  uint8_t StickExpo[3];              // Stick expo in %, per axis
+  uint8_t TpaThrottle[TPA_POINTS];   // Gain schedule breakpoints, throttle %
+  uint8_t TpaGain[3][TPA_POINTS];    // Gain schedule gain %, per axis
+  uint8_t RxSmoothing;               // Rx setpoint smoothing, 1/8 frames
+  uint8_t FrameType;                 // enum FrameType, see mixer.h
+  uint16_t OutputRate[MOTOR_OUTPUTS_ALL];  // Pulse rate (Hz), 0 = by output type
+
+  // By build profile (SETTINGS_LAYOUT) from here on
+  uint16_t RxMin[RX_CHANNELS];       // Calibrated Rx endpoints (ticks)
+  uint16_t RxCenter[RX_CHANNELS];
+  uint16_t RxMax[RX_CHANNELS];
+#ifdef GYRO_NOTCH
+  uint8_t NotchFreq[NOTCH_POINTS];   // Gyro notch centre (Hz) by throttle
+#endif
+#ifdef AUTOTUNE
+  uint16_t TunedGain[3];             // Autotuned gain, replaces pot if set
+  uint16_t TunedI[3];                // Autotuned I, D multipliers, Q8
+  uint16_t TunedD[3];
+#endif
 };
 /*** END TYPES ***/
 
@@ -0,0 +1,142 @@
+#include "spectrum.h"
+
+#ifdef SPECTRUM
+#include "gyros.h"
+#include "trig.h"
+
+/*** BEGIN VARIABLES ***/
+bool SpectrumEnabled;
+
+static int16_t spectrumCoef[SPECTRUM_BINS];  // 2 cos(w), Q14
+static int16_t spectrumS1[SPECTRUM_BINS];
+static int16_t spectrumS2[SPECTRUM_BINS];
+static int16_t spectrumQueue[SPECTRUM_QUEUE];
+static uint8_t spectrumHead;         // Next free queue slot
+static uint8_t spectrumTail;         // Next sample to process
+static uint8_t spectrumCount;        // Samples in this block
+static uint8_t spectrumBlocks;       // Blocks in this report
+static bool spectrumBlockDone;       // Block power not yet accumulated
+static bool spectrumReport;          // Report waiting for telemetry
+static struct spectrumRecord spectrumOut;
+/*** END VARIABLES ***/
+
+#define SPECTRUM_QUEUE_MASK (SPECTRUM_QUEUE - 1)
+
+void spectrumStart()
+{
+  for(uint8_t i = 0;i < SPECTRUM_BINS;i++) {
+    uint16_t f = SPECTRUM_F_MIN + i * SPECTRUM_F_STEP;
+
+    spectrumCoef[i] = 2 * trigCos(TRIG_ANGLE(f, ESC_RATE));
+  }
+
+  spectrumOut.sampleRate = ESC_RATE;
+  spectrumOut.fMin = SPECTRUM_F_MIN;
+  spectrumOut.fStep = SPECTRUM_F_STEP;
+  SpectrumEnabled = true;
+}
+
+/*
+ * Queue this frame's gyro sample for the current axis. Called once per
+ * loop, so the sample rate is the output frame rate.
+ */
+void spectrumSample()
+{
+  uint8_t next = (spectrumHead + 1) & SPECTRUM_QUEUE_MASK;
+
+  if(spectrumReport)
+    return;
+  if(next == spectrumTail) {
+    spectrumOut.overruns++;
+    return;
+  }
+
+#ifdef GYRO_MPU6050
+  spectrumQueue[spectrumHead] = gyroRate[spectrumOut.axis] >> SPECTRUM_INPUT_SHIFT;
+#else
+  spectrumQueue[spectrumHead] = gyroADC[spectrumOut.axis] >> SPECTRUM_INPUT_SHIFT;
+#endif
+  spectrumHead = next;
+}
+
+/*
+ * Goertzel power for each bin of the finished block,
+ * s1^2 + s2^2 - 2 cos(w) s1 s2, with one bit dropped to stay in
+ * 32 bits.
+ */
+static void spectrumAccumulate(void)
+{
+  for(uint8_t i = 0;i < SPECTRUM_BINS;i++) {
+    int16_t a = spectrumS1[i] >> 1;
+    int16_t b = spectrumS2[i] >> 1;
+    int32_t p;
+
+    p = (int32_t)a * a + (int32_t)b * b -
+      (((int32_t)a * b) >> 14) * spectrumCoef[i];
+    if(p > 0)
+      spectrumOut.power[i]+= (uint32_t)p >> SPECTRUM_BLOCKS_SHIFT;
+    spectrumS1[i] = 0;
+    spectrumS2[i] = 0;
+  }
+
+  if(++spectrumBlocks == 1 << SPECTRUM_BLOCKS_SHIFT) {
+    spectrumBlocks = 0;
+    spectrumReport = true;
+  }
+}
+
+/*
+ * Do one bounded piece of work: send a pending report, accumulate a
+ * finished block, or run one queued sample through all bins. Called
+ * from the output_motor_ppm() wait loop only while there is time
+ * left in the frame.
+ */
+void spectrumIdle()
+{
+  uint16_t start, t;
+  int16_t x;
+
+  cli();
+  start = TCNT1;
+  sei();
+
+  if(spectrumReport) {
+    if(telemetrySend(TELEMETRY_SPECTRUM, &spectrumOut, sizeof(spectrumOut))) {
+      spectrumReport = false;
+      spectrumTail = spectrumHead;   // Drop samples of the old axis
+      for(uint8_t i = 0;i < SPECTRUM_BINS;i++)
+        spectrumOut.power[i] = 0;
+      if(++spectrumOut.axis > YAW)
+        spectrumOut.axis = ROLL;
+    }
+  } else if(spectrumBlockDone) {
+    spectrumBlockDone = false;
+    spectrumAccumulate();
+  } else if(spectrumTail != spectrumHead) {
+    x = spectrumQueue[spectrumTail];
+    spectrumTail = (spectrumTail + 1) & SPECTRUM_QUEUE_MASK;
+
+    for(uint8_t i = 0;i < SPECTRUM_BINS;i++) {
+      int16_t s = x + (((int32_t)spectrumCoef[i] * spectrumS1[i]) >> 14) -
+        spectrumS2[i];
+
+      spectrumS2[i] = spectrumS1[i];
+      spectrumS1[i] = s;
+    }
+
+    if(++spectrumCount == SPECTRUM_N) {
+      spectrumCount = 0;
+      spectrumBlockDone = true;
+    }
+  } else {
+    return;
+  }
+
+  cli();
+  t = TCNT1;
+  sei();
+  t-= start;
+  if(t > spectrumOut.chunkMax)
+    spectrumOut.chunkMax = t;
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "config.h"
+#include "motors.h"
+#include "telemetry.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Vibration spectrum analysis. When enabled by the boot gesture, one
+ * Goertzel filter per frequency bin runs over the gyro of one axis at
+ * a time, in the idle time at the end of output_motor_ppm(), and the
+ * power per bin is sent as TELEMETRY_SPECTRUM records. Needs a serial
+ * receiver for the telemetry pin (see telemetry.h).
+ */
+//#define SPECTRUM
+
+#if defined(SPECTRUM) && !defined(TELEMETRY)
+#error "SPECTRUM needs TELEMETRY, which needs a serial receiver (RX_MODE) and no MINIMAL"
+#endif
+
+/*
+ * Gyro samples are taken once per output frame, so the sample rate
+ * is ESC_RATE and bins must stay below ESC_RATE / 2. Each bin is
+ * about ESC_RATE / SPECTRUM_N wide.
+ */
+#define SPECTRUM_BINS 16
+#define SPECTRUM_F_MIN 14            // Hz, first bin
+#define SPECTRUM_F_STEP 14           // Hz, bin spacing
+#define SPECTRUM_N 32                // Samples per Goertzel block
+
+/*
+ * Blocks per report (power of two); each axis is analysed for this
+ * many blocks, reported, then the next axis is started.
+ */
+#define SPECTRUM_BLOCKS_SHIFT 3
+
+/*
+ * Filter state is 16 bits, so scale the input so a tone peak times
+ * SPECTRUM_N / 2 stays in range.
+ */
+#ifdef GYRO_MPU6050
+#define SPECTRUM_INPUT_SHIFT 3
+#else
+#define SPECTRUM_INPUT_SHIFT 0
+#endif
+
+/*
+ * Only start processing a sample with at least this many timer1
+ * ticks left before the next output frame, and only after all
+ * software edges of this frame are done.
+ */
+#define SPECTRUM_IDLE_TICKS (160 * 8)
+
+#define SPECTRUM_QUEUE 8             // Pending samples, power of two
+
+#if defined(SPECTRUM) && SPECTRUM_F_MIN + (SPECTRUM_BINS - 1) * SPECTRUM_F_STEP >= ESC_RATE / 2
+#error "SPECTRUM bins must stay below ESC_RATE / 2"
+#endif
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+struct spectrumRecord {
+  uint8_t axis;
+  uint16_t sampleRate;               // Hz
+  uint16_t fMin, fStep;              // Hz
+  uint16_t chunkMax;                 // Longest idle chunk, timer1 ticks
+  uint16_t overruns;                 // Samples dropped, queue full
+  uint32_t power[SPECTRUM_BINS];
+};
+/*** END TYPES ***/
+
+/*** BEGIN VARIABLES ***/
+extern bool SpectrumEnabled;
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void spectrumStart(void);
+void spectrumSample(void);
+void spectrumIdle(void);
+/*** END PROTOTYPES ***/
+
+#endif
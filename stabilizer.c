@@ -0,0 +1,118 @@
+#include "stabilizer.h"
+
+#include <avr/pgmspace.h>
+#include "gyros.h"
+#include "mixer.h"
+#include "settings.h"
+
+/*** BEGIN VARIABLES ***/
+static struct stabilizer stabilizer;
+
+static const uint8_t stabilizerWeight[2][3] PROGMEM = {
+  { STAB_UNTUNED_WEIGHT_ROLL, STAB_UNTUNED_WEIGHT_PITCH, STAB_UNTUNED_WEIGHT_YAW },
+  { STAB_WEIGHT_ROLL, STAB_WEIGHT_PITCH, STAB_WEIGHT_YAW }
+};
+#ifdef STAB_FF
+static const uint8_t stabilizerFF[3] PROGMEM = {
+  STAB_FF_ROLL, STAB_FF_PITCH, STAB_FF_YAW
+};
+#endif
+static const uint8_t stabilizerUntuned[3] PROGMEM = {
+  STAB_UNTUNED_ROLL, STAB_UNTUNED_PITCH, STAB_UNTUNED_YAW
+};
+/*** END VARIABLES ***/
+
+/*
+ * Forget the last flight. The first call per axis afterwards only
+ * records the setpoint and gyro, so arming with the sticks or the
+ * craft moving gives no D or FF kick.
+ */
+void stabilizerReset()
+{
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    stabilizer.axis[i].integral = 0;
+#ifdef STAB_FF
+    stabilizer.axis[i].ff = 0;
+#endif
+  }
+  stabilizer.primed = 0;
+}
+
+/*
+ * Conditional integration: hold the integral while the mixer reports
+ * that this axis cannot go any further in the error's direction.
+ */
+static inline bool stabilizerWindup(uint8_t axis, int16_t error)
+{
+  if(error > 0)
+    return MixerSaturated & MIXER_SAT_POS(axis);
+  return error < 0 && (MixerSaturated & MIXER_SAT_NEG(axis));
+}
+
+/*
+ * One frame of an axis, from setpoint and gyro (both already scaled
+ * by the gyro gain, so e carries the P gain) to the mixer input.
+ * Autotuned I and D are used when the axis has a tuned gain.
+ */
+int16_t stabilizerApply(uint8_t axis, int16_t setpoint, int16_t gyro, int16_t imax)
+{
+  struct stabilizerAxis *s = &stabilizer.axis[axis];
+  int16_t error, emax, derivative, ff = 0;
+  uint16_t ki, kd;
+  uint8_t weight;
+  int32_t limit;
+
+  if(!(stabilizer.primed & _BV(axis))) {
+    s->gyro = gyro;
+#ifdef STAB_FF
+    s->setpoint = setpoint;
+#endif
+    stabilizer.primed|= _BV(axis);
+  }
+
+#ifdef AUTOTUNE
+  if(Config.TunedGain[axis]) {
+    ki = Config.TunedI[axis];
+    kd = Config.TunedD[axis];
+    weight = pgm_read_byte(&stabilizerWeight[1][axis]);
+    emax = STAB_ERROR_MAX;
+    limit = (int32_t)imax << 8;
+  } else
+#endif
+  {
+    ki = kd = pgm_read_byte(&stabilizerUntuned[axis]);
+    weight = pgm_read_byte(&stabilizerWeight[0][axis]);
+    emax = ki ? STAB_ERROR_MAX : INT16_MAX;
+    limit = (int32_t)imax * ki;
+  }
+
+  error = setpoint - gyro;
+  if(error > emax)
+    error = emax;
+  else if(error < -emax)
+    error = -emax;
+
+  if(!stabilizerWindup(axis, error))
+    s->integral+= (int32_t)error * ki;
+  if(s->integral > limit)
+    s->integral = limit;
+  else if(s->integral < -limit)
+    s->integral = -limit;
+
+#ifdef STAB_FF
+  ff = (setpoint - s->setpoint) * pgm_read_byte(&stabilizerFF[axis]);
+  if(ff > STAB_FF_MAX)
+    ff = STAB_FF_MAX;
+  else if(ff < -STAB_FF_MAX)
+    ff = -STAB_FF_MAX;
+  s->ff+= ((ff << 4) - s->ff) >> STAB_FF_SHIFT;
+  s->setpoint = setpoint;
+  ff = s->ff >> 4;
+#endif
+
+  derivative = ((int32_t)(s->gyro - gyro) * kd) >> 8;    // On measurement
+  s->gyro = gyro;
+
+  return error + (int16_t)(((int32_t)setpoint * (weight - 64)) >> 6) +
+    (int16_t)(s->integral >> 8) + derivative + ff;
+}
@@ -0,0 +1,85 @@
+#ifndef STABILIZER_H
+#define STABILIZER_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Two-degree-of-freedom rate stabilizer. The setpoint (scaled stick)
+ * and the measurement (scaled gyro) take separate paths:
+ *
+ *   out = e + (w - 1) * sp + I(e) - Kd * d(gyro) + FF(d(sp))
+ *
+ * where e = sp - gyro. The proportional setpoint weight w shapes the
+ * stick response without touching the feedback gain; the derivative
+ * is taken on the gyro alone, so stick moves give no derivative kick;
+ * the feed-forward term acts on the stick rate of change, so the
+ * response starts before an error has built up.
+ *
+ * Weights are Q6 (64 = 1.0, plain PID setpoint-wise) and apply to
+ * axes with autotuned gains; untuned axes keep the laws below.
+ */
+#define STAB_WEIGHT_ROLL 64
+#define STAB_WEIGHT_PITCH 64
+#define STAB_WEIGHT_YAW 64
+
+/*
+ * Feed-forward: setpoint change per frame (at ESC_RATE) times
+ * STAB_FF_*, clamped to STAB_FF_MAX. The receiver updates much less
+ * often than the loop runs, so the term is smoothed over about
+ * (1 << STAB_FF_SHIFT) frames. Off by default, so the sticks answer
+ * as they always did; 4, 4, 2 is a place to start (see the step test
+ * in test/stabilizer_test.c).
+ */
+#ifndef STAB_FF_ROLL
+#define STAB_FF_ROLL 0
+#define STAB_FF_PITCH 0
+#define STAB_FF_YAW 0
+#endif
+#define STAB_FF_MAX 500
+#define STAB_FF_SHIFT 3
+#if STAB_FF_ROLL > 0 || STAB_FF_PITCH > 0 || STAB_FF_YAW > 0
+#define STAB_FF                      // Keeps the state for it
+#endif
+
+/*
+ * I and D (Q8, per frame) and setpoint weight of an axis without
+ * autotuned gains. Yaw always had a slow PID and passed the stick
+ * through once more (2.0); roll and pitch are P only.
+ */
+#define STAB_UNTUNED_ROLL 0
+#define STAB_UNTUNED_PITCH 0
+#define STAB_UNTUNED_YAW 16
+#define STAB_UNTUNED_WEIGHT_ROLL 64
+#define STAB_UNTUNED_WEIGHT_PITCH 64
+#define STAB_UNTUNED_WEIGHT_YAW 128
+
+/*
+ * Error clamp of an axis with an I term (autotuned, or untuned yaw),
+ * as those always had; the P-only axes pass the error as it is.
+ */
+#define STAB_ERROR_MAX 1023
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+struct stabilizerAxis {
+  int32_t integral;                  // Q8
+  int16_t gyro;                      // Last measurement, for D
+#ifdef STAB_FF
+  int16_t setpoint;                  // Last setpoint, for FF
+  int16_t ff;                        // Smoothed feed-forward, Q4
+#endif
+};
+
+struct stabilizer {
+  struct stabilizerAxis axis[3];
+  uint8_t primed;                    // Bit per axis: last values are valid
+};
+/*** END TYPES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void stabilizerReset(void);
+int16_t stabilizerApply(uint8_t axis, int16_t setpoint, int16_t gyro, int16_t imax);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -0,0 +1,41 @@
+#include "sticks.h"
+
+#include "gyros.h"
+#include "receiver.h"
+#include "settings.h"
+
+int16_t StickCurve[3][STICK_CURVE_POINTS];
+
+/*
+ * Rebuild the rate/expo curve for each axis. The gain pot value is
+ * folded into the table, so this must be called whenever Config or
+ * GainPotADC[] changes. An autotuned gain replaces only the gyro
+ * gain (GainInADC[]); the stick rate stays on the pot.
+ *
+ * y = gain * rate * ((1 - expo) * x + expo * x^3 / STICK_FULL^2)
+ */
+void sticksBuildCurves()
+{
+  uint8_t axis, i;
+  uint8_t rate, expo;
+  int32_t x, y;
+
+  for(axis = ROLL;axis <= YAW;axis++) {
+    rate = Config.StickRate[axis];
+    if(rate > STICK_RATE_MAX)
+      rate = STICK_RATE_MAX;
+    expo = Config.StickExpo[axis];
+    if(expo > STICK_EXPO_MAX)
+      expo = STICK_EXPO_MAX;
+
+    for(i = 0;i < STICK_CURVE_POINTS;i++) {
+      x = (int32_t)i << STICK_CURVE_SHIFT;
+      y = x * (100 - expo) + (x * x / STICK_FULL) * x / STICK_FULL * expo;
+      y = y / 100 * rate / 100;
+      y = (y * GainPotADC[axis]) >> STICK_GAIN_SHIFT;
+      if(y > INT16_MAX)
+        y = INT16_MAX;
+      StickCurve[axis][i] = y;
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef STICKS_H
+#define STICKS_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+// Default stick rate (% of the linear response at full deflection)
+#define STICK_RATE_DEFAULT 100
+#define STICK_RATE_MAX 200
+
+// Default stick expo (% of cubic blended into the linear response)
+#define STICK_EXPO_DEFAULT 0
+#define STICK_EXPO_MAX 100
+
+// Rx units at full stick deflection
+#define STICK_FULL 1000
+
+/*
+ * Curve table: segments of (1 << STICK_CURVE_SHIFT) Rx units each,
+ * as many as cover 0..STICK_FULL. Inputs beyond full deflection are
+ * clamped to it.
+ */
+#ifdef MINIMAL
+#define STICK_CURVE_SHIFT 8
+#else
+#define STICK_CURVE_SHIFT 6
+#endif
+#define STICK_CURVE_POINTS (((STICK_FULL - 1) >> STICK_CURVE_SHIFT) + 2)
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+/*
+ * In RAM (3 * STICK_CURVE_POINTS words): the points fold in the gain
+ * pots and the rate/expo settings, which change at run time. A flash
+ * table could only hold a fixed curve shape, leaving the expo blend
+ * and the gain as extra multiplies per axis per frame.
+ */
+extern int16_t StickCurve[3][STICK_CURVE_POINTS];
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void sticksBuildCurves(void);
+/*** END PROTOTYPES ***/
+
+/*
+ * Look up the scaled stick value for an axis, interpolating linearly
+ * between table points. The curves are odd-symmetric, so only the
+ * positive half is stored. The interpolation is one signed 16-bit by
+ * 8-bit multiply with a 32-bit product (a segment rise times the
+ * fraction can exceed 16 bits), in place of the 32x32-bit stick gain
+ * multiply it replaces.
+ */
+static inline int16_t sticksApply(uint8_t axis, int16_t x)
+{
+  const int16_t *t = StickCurve[axis];
+  uint16_t a;
+  uint8_t i, f;
+  int16_t y;
+
+  a = x < 0 ? -x : x;
+  if(a > STICK_FULL)
+    a = STICK_FULL;
+  i = a >> STICK_CURVE_SHIFT;
+  f = a & ((1 << STICK_CURVE_SHIFT) - 1);
+  y = t[i] + (((int32_t)(t[i + 1] - t[i]) * f) >> STICK_CURVE_SHIFT);
+
+  return x < 0 ? -y : y;
+}
+
+#endif
@@ -0,0 +1,79 @@
+#include "telemetry.h"
+
+#ifdef TELEMETRY
+
+/*** BEGIN VARIABLES ***/
+uint16_t TelemetryDropped;
+
+static uint8_t telemetryBuffer[TELEMETRY_BUFFER];
+static uint8_t telemetryHead;        // Written by telemetrySend()
+static volatile uint8_t telemetryTail;  // Advanced by the interrupt
+/*** END VARIABLES ***/
+
+#define TELEMETRY_MASK (TELEMETRY_BUFFER - 1)
+
+/*
+ * The UART is already set up by serialRxSetup(); just add the
+ * transmitter.
+ */
+void telemetrySetup()
+{
+  UCSR0B|= _BV(TXEN0);
+}
+
+ISR(USART_UDRE_vect)
+{
+  uint8_t tail = telemetryTail;
+
+  UDR0 = telemetryBuffer[tail];
+  tail = (tail + 1) & TELEMETRY_MASK;
+  telemetryTail = tail;
+  if(tail == telemetryHead)
+    UCSR0B&= ~_BV(UDRIE0);
+}
+
+static inline void telemetryPut(uint8_t *head, uint8_t b)
+{
+  telemetryBuffer[*head] = b;
+  *head = (*head + 1) & TELEMETRY_MASK;
+}
+
+/*
+ * Queue a whole record, or nothing if it does not fit. Never waits
+ * for the UART, so it is safe to call from the idle hook.
+ */
+bool telemetrySend(uint8_t type, const void *data, uint8_t length)
+{
+  const uint8_t *p = data;
+  uint8_t head = telemetryHead;
+  uint8_t room = (telemetryTail - head - 1) & TELEMETRY_MASK;
+  uint8_t sum = type + length;
+
+  if(room < length + 4) {
+    TelemetryDropped++;
+    return false;
+  }
+
+  telemetryPut(&head, TELEMETRY_SYNC);
+  telemetryPut(&head, type);
+  telemetryPut(&head, length);
+  for(uint8_t i = 0;i < length;i++) {
+    sum+= p[i];
+    telemetryPut(&head, p[i]);
+  }
+  telemetryPut(&head, sum);
+
+  telemetryHead = head;
+  UCSR0B|= _BV(UDRIE0);
+  return true;
+}
+
+/*
+ * Wait until everything queued has gone to the UART.
+ */
+void telemetryFlush()
+{
+  while(telemetryTail != telemetryHead)
+    ;
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "config.h"
+#include "receiver.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Telemetry goes out on the UART TXD pin (PD1). That is the roll Rx
+ * input with a PWM receiver, so telemetry needs a serial receiver
+ * (RX_MODE), and runs at its baud rate and framing. Not in the
+ * MINIMAL build.
+ */
+#if RX_MODE != RX_PWM && !defined(MINIMAL)
+#define TELEMETRY
+#endif
+
+/*
+ * Record framing:
+ *   TELEMETRY_SYNC, type, length, payload[length], checksum
+ * where checksum is the 8-bit sum of type, length and payload.
+ * Multi-byte values are little-endian.
+ */
+#define TELEMETRY_SYNC 0xa5
+
+// Record types
+#define TELEMETRY_SPECTRUM 1
+#define TELEMETRY_CAPTURE_START 2
+#define TELEMETRY_CAPTURE_FRAME 3
+#define TELEMETRY_DEADLINE 4         // struct motorDeadline, every second
+#define TELEMETRY_LATENCY 5          // struct latencyStats (LATENCY_TRACE)
+
+// Transmit buffer size, power of two
+#define TELEMETRY_BUFFER 128
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern uint16_t TelemetryDropped;    // Records that did not fit
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void telemetrySetup(void);
+bool telemetrySend(uint8_t type, const void *data, uint8_t length);
+void telemetryFlush(void);
+/*** END PROTOTYPES ***/
+
+#endif
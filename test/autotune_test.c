@@ -0,0 +1,238 @@
+/*
+ * Relay autotune (autotune.c) on a simulated airframe. Each axis is a
+ * rate plant: a first-order motor lag driving inertia with drag,
+ * sampled once a frame, with the output of a frame applied over the
+ * next one. The tuned period and gain are checked against the
+ * ultimate point of the plant worked out from its frequency response;
+ * then that the results are saved and change the gyro gain only, not
+ * the stick curves.
+ */
+#include "autotune.h"
+
+#include <math.h>
+#include <setjmp.h>
+#include <string.h>
+#include <avr/eeprom.h>
+
+#include "gyros.h"
+#include "motors.h"
+#include "receiver.h"
+#include "settings.h"
+#include "sticks.h"
+#include "timers.h"
+#include "tpa.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_DT (1.0 / ESC_RATE)
+#define TEST_SUBSTEPS 20
+#define TEST_MOTOR_TAU 0.03          // s
+#define TEST_DRAG_TAU 0.5            // s
+#define TEST_DELAY (1.5 * TEST_DT)   // Frame of output delay, plus hold
+#define TEST_COLLECTIVE 500
+#define TEST_POT 600
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What the modules under test need from the rest of the firmware
+int16_t RxInRoll, RxInPitch, RxInCollective, RxInYaw;
+void RxGetChannels(void) { }
+
+static jmp_buf *testHalt;            // Where a halted loop comes back to
+
+/*
+ * A frame of the outputs stopped; one past the LED flashes and the
+ * save (frames wait out EEPROM writes), with testHalt set, is the
+ * firmware halted for good.
+ */
+void motorsStopFrame(void)
+{
+  if(testHalt && !timersFlashing() && eeprom_is_ready())
+    longjmp(*testHalt, 1);
+  hostDelay(1e6 / ESC_RATE);
+  timersUpdate();
+}
+
+// Gyro units per s^2 per output unit, per axis
+static const double testGain[3] = { 256, 200, 120 };
+
+static struct {
+  double rate;                       // Gyro units
+  double motor;                      // Output units, after the lag
+  int16_t out;                       // Applied this frame
+} testAxis[3];
+/*** END VARIABLES ***/
+
+/*
+ * Phase and magnitude of an axis at w rad/s, with the delay.
+ */
+static double testPhase(double w)
+{
+  return -w * TEST_DELAY - atan(w * TEST_MOTOR_TAU) - atan(w * TEST_DRAG_TAU);
+}
+
+static double testMagnitude(uint8_t axis, double w)
+{
+  return testGain[axis] / (sqrt(1 + w * w * TEST_MOTOR_TAU * TEST_MOTOR_TAU) *
+    sqrt(w * w + 1 / (TEST_DRAG_TAU * TEST_DRAG_TAU)));
+}
+
+/*
+ * Bisect for the w where f() goes negative, phase falling with w.
+ */
+static double testSolve(uint8_t axis, double (*f)(uint8_t, double))
+{
+  double lo = 1, hi = 2000, w = lo;
+
+  for(uint8_t i = 0;i < 60;i++) {
+    w = (lo + hi) / 2;
+    if(f(axis, w) > 0)
+      lo = w;
+    else
+      hi = w;
+  }
+  return w;
+}
+
+/*
+ * Ultimate point: phase -180 degrees.
+ */
+static double testUltimate(uint8_t axis, double w)
+{
+  return testPhase(w) + M_PI;
+}
+
+/*
+ * The relay's own oscillation (describing function): the hysteresis
+ * lets it run where the phase is -180 degrees + asin(e / a), a little
+ * slower than the ultimate point.
+ */
+static double testAmplitude(uint8_t axis, double w)
+{
+  return 4 * AUTOTUNE_RELAY * testMagnitude(axis, w) / M_PI;
+}
+
+static double testRelay(uint8_t axis, double w)
+{
+  double a = testAmplitude(axis, w);
+
+  return testPhase(w) + M_PI - (a > AUTOTUNE_HYSTERESIS ?
+    asin(AUTOTUNE_HYSTERESIS / a) : M_PI / 2);
+}
+
+static bool testNormal(uint8_t axis)
+{
+  return (axis == ROLL ? Config.RollGyroDirection :
+    axis == PITCH ? Config.PitchGyroDirection :
+    Config.YawGyroDirection) == GYRO_NORMAL;
+}
+
+/*
+ * One frame: sample the gyros, run the relay, move the plant on.
+ */
+static void testFrame(void)
+{
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    int16_t g = lround(testAxis[i].rate);
+
+    gyroADC[i] = testNormal(i) ? -g : g;
+  }
+
+  autotuneStep();
+
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    for(uint8_t s = 0;s < TEST_SUBSTEPS;s++) {
+      double h = TEST_DT / TEST_SUBSTEPS;
+
+      testAxis[i].motor+= (testAxis[i].out - testAxis[i].motor) * h / TEST_MOTOR_TAU;
+      testAxis[i].rate+= (testGain[i] * testAxis[i].motor -
+        testAxis[i].rate / TEST_DRAG_TAU) * h;
+    }
+    testAxis[i].out = AutotuneAxis == i ? AutotuneOutput : 0;
+  }
+}
+
+static void testTune(void)
+{
+  int16_t curve[3][STICK_CURVE_POINTS];
+  struct config saved;
+  uint16_t frames[3] = { 0, 0, 0 };
+
+  for(uint8_t i = 3;i <= 5;i++)
+    HostAdc[i] = TEST_POT;
+  settingsSetup();
+  ReadGainPots();
+  sticksBuildCurves();
+  tpaBuildTable();
+  memcpy(curve, StickCurve, sizeof(curve));
+
+  RxInCollective = TEST_COLLECTIVE;
+  autotuneStart();
+  for(uint16_t n = 0;n < 10 * ESC_RATE;n++) {
+    testFrame();
+    if(AutotuneAxis != AUTOTUNE_IDLE)
+      frames[AutotuneAxis]++;
+  }
+  HOST_CHECK(AutotuneAxis == AUTOTUNE_IDLE);
+
+  autotuneFinish();
+  eeprom_read_block(&saved, (void *)EEPROM_DATA_START_POS, sizeof(saved));
+
+  /*
+   * The relay is expected to find its own oscillation to within the
+   * frame it samples at; from that, Ziegler-Nichols' 0.6 Ku to within
+   * the error of the relay method, worse at small amplitudes.
+   */
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    double percent = 100.0 / tpaPercent(i, TEST_COLLECTIVE);
+    double scale = 0.6 * (1 << GYRO_GAIN_SHIFT) * percent;
+    double wr = testSolve(i, testRelay), wu = testSolve(i, testUltimate);
+    double a = testAmplitude(i, wr);
+    double period = 2 * M_PI / wr / TEST_DT;
+    double relay = scale * 4 * AUTOTUNE_RELAY /
+      (M_PI * sqrt(a * a - AUTOTUNE_HYSTERESIS * AUTOTUNE_HYSTERESIS));
+    double gain = scale / testMagnitude(i, wu);
+
+    printf("axis %u: %u frames, period %.1f (%.1f), gain %u (%.1f, 0.6 Ku %.1f)\n",
+      i, frames[i], Config.TunedD[i] / 32.0, period, Config.TunedGain[i],
+      relay, gain);
+
+    HOST_CHECK(frames[i] > 0);
+    HOST_CHECK(fabs(Config.TunedD[i] / 32.0 - period) < 0.1 * period);
+    HOST_CHECK(abs(Config.TunedI[i] - (int)lround(512 / period)) <= 2);
+    HOST_CHECK(fabs(Config.TunedGain[i] - relay) < 0.15 * relay);
+    HOST_CHECK(fabs(Config.TunedGain[i] - gain) < 0.25 * gain);
+
+    HOST_CHECK(saved.TunedGain[i] == Config.TunedGain[i]);
+    HOST_CHECK(saved.TunedI[i] == Config.TunedI[i]);
+    HOST_CHECK(saved.TunedD[i] == Config.TunedD[i]);
+    HOST_CHECK(GainInADC[i] == Config.TunedGain[i]);
+    HOST_CHECK(GainPotADC[i] == TEST_POT);
+  }
+  HOST_CHECK(memcmp(curve, StickCurve, sizeof(curve)) == 0);
+}
+
+/*
+ * Clearing the settings writes the defaults to the EEPROM before it
+ * halts: the tuned gains saved above go.
+ */
+static void testClear(void)
+{
+  struct config saved;
+  jmp_buf halt;
+
+  testHalt = &halt;
+  if(!setjmp(halt))
+    settingsClearAll();
+  testHalt = NULL;
+  eeprom_read_block(&saved, (void *)EEPROM_DATA_START_POS, sizeof(saved));
+  for(uint8_t i = ROLL;i <= YAW;i++)
+    HOST_CHECK(saved.TunedGain[i] == 0);
+  HOST_CHECK(saved.setup == SETTINGS_VERSION);
+}
+
+int main(void)
+{
+  testTune();
+  testClear();
+  return hostDone("autotune");
+}
@@ -0,0 +1,100 @@
+/*
+ * Rx failsafe (RxGetChannels() in receiver.c), built with two PWM aux
+ * channels. Pulses come at 50Hz and the loop runs at ESC_RATE. An
+ * aux channel that stops on its own must read RX_FAILSAFE_AUX once it
+ * is RX_FAILSAFE_US old, with the sticks still live and the link up.
+ * The primary channels stopping must fail the whole link, aux
+ * channels included, and the link must come back with the pulses.
+ */
+#include "../receiver.c"
+
+/*** BEGIN DEFINES ***/
+#define TEST_FRAME_US 20000          // 50Hz receiver
+#define TEST_LOOP_US 2222            // ESC_RATE
+#define TEST_ROLL (1700 * 8)         // +360 with the default endpoints
+#define TEST_AUX (2000 * 8)
+#define TEST_LOOPS(us) ((us) / TEST_LOOP_US + 1)
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What receiver.c needs from the rest of the firmware
+void motorsStopFrame(void) { }
+
+static uint32_t testNext;            // HostTicks of the next frame
+/*** END VARIABLES ***/
+
+/*
+ * A loop's worth of time; a frame of pulses, all ended, when one is
+ * due: the primary channels if `sticks`, the aux ones if `aux`.
+ */
+static void testLoop(bool sticks, bool aux)
+{
+  hostDelay(TEST_LOOP_US);
+  if((int32_t)(HostTicks - testNext) >= 0) {
+    uint16_t start = HostTicks - TEST_AUX;
+
+    if(sticks) {
+      RxChannel1Start = start;
+      RxChannel1 = TEST_ROLL;
+      RxChannel2Start = start;
+      RxChannel2 = RX_DEFAULT_CENTER;
+      RxChannel3Start = start;
+      RxChannel3 = RX_DEFAULT_THROTTLE_MIN;
+      RxChannel4Start = start;
+      RxChannel4 = RX_DEFAULT_CENTER;
+    }
+    if(aux) {
+      for(uint8_t i = 0;i < RX_AUX_PINS;i++) {
+        rxAuxStart[i] = start;
+        RxAuxChannel[i] = TEST_AUX;
+      }
+    }
+    testNext+= TEST_FRAME_US * 8;
+  }
+  RxGetChannels();
+}
+
+int main(void)
+{
+  Set_EEPROM_Default_Config();
+  receiverSetup();
+  receiverBuildScales();
+  testNext = HostTicks;
+
+  // All channels live
+  for(uint16_t i = 0;i < TEST_LOOPS(4 * TEST_FRAME_US);i++)
+    testLoop(true, true);
+  HOST_CHECK(!RxFailsafe);
+  HOST_CHECK(RxInRoll > 300);
+  HOST_CHECK(RxInAux[0] > 900 && RxInAux[1] > 900);
+
+  // The aux channels stop: they fail on their own, the sticks do not
+  for(uint16_t i = 0;i < TEST_LOOPS(RX_FAILSAFE_US + TEST_FRAME_US);i++)
+    testLoop(true, false);
+  HOST_CHECK(!RxFailsafe);
+  HOST_CHECK(RxFailsafeCount == 0);
+  HOST_CHECK(RxInRoll > 300);
+  HOST_CHECK(RxInAux[0] == RX_FAILSAFE_AUX && RxInAux[1] == RX_FAILSAFE_AUX);
+
+  // And come back
+  for(uint16_t i = 0;i < TEST_LOOPS(2 * TEST_FRAME_US);i++)
+    testLoop(true, true);
+  HOST_CHECK(RxInAux[0] > 900 && RxInAux[1] > 900);
+
+  // The sticks stop: the link fails, aux channels and all
+  for(uint16_t i = 0;i < TEST_LOOPS(RX_FAILSAFE_US + TEST_FRAME_US);i++)
+    testLoop(false, true);
+  HOST_CHECK(RxFailsafe);
+  HOST_CHECK(RxFailsafeCount == 1);
+  HOST_CHECK(RxInRoll == RX_FAILSAFE_ROLL);
+  HOST_CHECK(RxInCollective == RX_FAILSAFE_COLLECTIVE);
+  HOST_CHECK(RxInAux[0] == RX_FAILSAFE_AUX && RxInAux[1] == RX_FAILSAFE_AUX);
+
+  // And come back
+  for(uint16_t i = 0;i < TEST_LOOPS(2 * TEST_FRAME_US);i++)
+    testLoop(true, true);
+  HOST_CHECK(!RxFailsafe);
+  HOST_CHECK(RxInRoll > 300);
+
+  return hostDone("failsafe");
+}
@@ -0,0 +1,20 @@
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+// EEPROM is HostEeprom[] (see host.h)
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dest, const void *src, size_t size);
+void eeprom_write_block(const void *src, void *dest, size_t size);
+bool hostEepromIdle(void);
+void hostEepromWait(void);
+#define eeprom_is_ready() hostEepromIdle()
+#define eeprom_busy_wait() hostEepromWait()
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+/*
+ * Interrupt handlers are plain functions; tests run them with
+ * hostIsr(). cli() and sei() keep the I flag (see host.h).
+ */
+#include "host.h"
+
+#define ISR(vector, ...) void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void) {}
+#define ISR_NAKED
+#define ISR_NOBLOCK
+
+#define cli() hostCli()
+#define sei() hostSei()
+
+#endif
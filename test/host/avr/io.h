@@ -0,0 +1,276 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+/*
+ * Host stand-in for <avr/io.h> (ATmega328P). The I/O registers are
+ * plain variables (defined in host.c); timer1 and timer2 are modelled
+ * as described in host.h.
+ */
+#include <stdint.h>
+
+#include "host.h"
+
+#define _BV(bit) (1 << (bit))
+#define RAMEND 0x8ff
+
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while(bit_is_clear(sfr, bit))
+
+#define HOST_REGS8(X) \
+  X(PINB) X(DDRB) X(PORTB) X(PINC) X(DDRC) X(PORTC) X(PIND) X(DDRD) \
+  X(PORTD) X(TIFR0) X(TIFR1) X(PCIFR) X(EIFR) X(EIMSK) X(GPIOR0) \
+  X(EECR) X(EEDR) X(TCCR0A) X(TCCR0B) X(TCNT0) X(OCR0A) X(OCR0B) \
+  X(GPIOR1) X(GPIOR2) X(SPCR) X(SPSR) X(SPDR) X(ACSR) X(SMCR) \
+  X(MCUSR) X(MCUCR) X(SPMCSR) X(SREG) X(WDTCSR) X(CLKPR) X(PRR) \
+  X(OSCCAL) X(PCICR) X(EICRA) X(PCMSK0) X(PCMSK1) X(PCMSK2) X(TIMSK0) \
+  X(TIMSK1) X(TIMSK2) X(ADCL) X(ADCH) X(ADCSRB) X(ADMUX) \
+  X(DIDR0) X(DIDR1) X(TCCR1A) X(TCCR1B) X(TCCR1C) X(TCNT1L) X(TCNT1H) \
+  X(TCCR2A) X(TCCR2B) X(OCR2A) X(OCR2B) X(ASSR) X(TWBR) X(TWSR) \
+  X(TWAR) X(TWDR) X(TWCR) X(TWAMR) X(UCSR0A) X(UCSR0B) X(UCSR0C) \
+  X(UBRR0L) X(UBRR0H) X(UDR0) X(ICR1L) X(ICR1H)
+
+#define HOST_REGS16(X) \
+  X(ADCW) X(ADC) X(UBRR0) X(EEAR)
+
+#define HOST_REG_EXTERN8(r) extern volatile uint8_t r;
+#define HOST_REG_EXTERN16(r) extern volatile uint16_t r;
+HOST_REGS8(HOST_REG_EXTERN8)
+HOST_REGS16(HOST_REG_EXTERN16)
+
+// timer1 and timer2 (see host.h)
+extern volatile uint16_t HostTCNT1, HostOCR1A, HostOCR1B, HostICR1;
+#define TCNT1 (*hostTimer1(&HostTCNT1))
+#define OCR1A (*hostTimer1(&HostOCR1A))
+#define OCR1B (*hostTimer1(&HostOCR1B))
+#define ICR1 (*hostTimer1(&HostICR1))
+#define TCNT2 (*hostTimer2Count())
+#define TIFR2 (*hostTimer2Flags())
+
+// ADC (see host.h)
+extern volatile uint8_t HostADCSRA;
+#define ADCSRA (*hostAdc())
+
+#define PUD 4
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM00 0
+#define WGM01 1
+#define WGM02 3
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+#define FOC0B 6
+#define FOC0A 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM10 0
+#define WGM11 1
+#define WGM12 3
+#define WGM13 4
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define FOC1B 6
+#define FOC1A 7
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOIE2 0
+#define OCIE2A 1
+#define OCIE2B 2
+#define TOV2 0
+#define OCF2A 1
+#define OCF2B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS0 6
+#define REFS1 7
+#define ADLAR 5
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+#define WDIE 6
+#define WDE 3
+#define WDCE 4
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ02 2
+#define UMSEL01 7
+#define UMSEL00 6
+#define UPM01 5
+#define UPM00 4
+#define USBS0 3
+#define UCSZ01 2
+#define UCSZ00 1
+#define UCPOL0 0
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+#define TWPS0 0
+#define TWPS1 1
+#define EERE 0
+#define EEPE 1
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT15 7
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+#define PB0 0
+#define DDB0 0
+#define PINB0 0
+#define PB1 1
+#define DDB1 1
+#define PINB1 1
+#define PB2 2
+#define DDB2 2
+#define PINB2 2
+#define PB3 3
+#define DDB3 3
+#define PINB3 3
+#define PB4 4
+#define DDB4 4
+#define PINB4 4
+#define PB5 5
+#define DDB5 5
+#define PINB5 5
+#define PB6 6
+#define DDB6 6
+#define PINB6 6
+#define PB7 7
+#define DDB7 7
+#define PINB7 7
+#define PC0 0
+#define DDC0 0
+#define PINC0 0
+#define PC1 1
+#define DDC1 1
+#define PINC1 1
+#define PC2 2
+#define DDC2 2
+#define PINC2 2
+#define PC3 3
+#define DDC3 3
+#define PINC3 3
+#define PC4 4
+#define DDC4 4
+#define PINC4 4
+#define PC5 5
+#define DDC5 5
+#define PINC5 5
+#define PC6 6
+#define DDC6 6
+#define PINC6 6
+#define PC7 7
+#define DDC7 7
+#define PINC7 7
+#define PD0 0
+#define DDD0 0
+#define PIND0 0
+#define PD1 1
+#define DDD1 1
+#define PIND1 1
+#define PD2 2
+#define DDD2 2
+#define PIND2 2
+#define PD3 3
+#define DDD3 3
+#define PIND3 3
+#define PD4 4
+#define DDD4 4
+#define PIND4 4
+#define PD5 5
+#define DDD5 5
+#define PIND5 5
+#define PD6 6
+#define DDD6 6
+#define PIND6 6
+#define PD7 7
+#define DDD7 7
+#define PIND7 7
+#define TOIE0 0
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include "host.h"
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode) do { } while(0)
+#define sleep_enable() do { } while(0)
+#define sleep_disable() do { } while(0)
+#define sleep_cpu() hostSleep()
+
+#endif
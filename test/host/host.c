@@ -0,0 +1,175 @@
+#include "host.h"
+
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <string.h>
+
+/*** BEGIN VARIABLES ***/
+#define HOST_REG_DEFINE8(r) volatile uint8_t r;
+#define HOST_REG_DEFINE16(r) volatile uint16_t r;
+HOST_REGS8(HOST_REG_DEFINE8)
+HOST_REGS16(HOST_REG_DEFINE16)
+volatile uint16_t HostTCNT1, HostOCR1A, HostOCR1B, HostICR1;
+volatile uint8_t HostADCSRA;
+
+// The Rx interrupt registers of receiver.h
+volatile uint16_t i_tmp;
+volatile uint16_t RxChannel1Start;
+volatile uint16_t RxChannel2Start;
+volatile uint16_t RxChannel3Start;
+volatile uint16_t RxChannel4Start;
+volatile uint8_t i_sreg;
+
+uint32_t HostTicks;
+uint16_t HostTickStep = 1;
+bool HostInterrupts;
+uint16_t HostUnguarded;
+void (*HostTimer1Access)(void);
+void (*HostSei)(void);
+uint16_t HostAdc[8];
+
+uint8_t HostEeprom[1024];
+uint16_t HostEepromWrites;
+uint32_t HostEepromWaited;
+void (*HostEepromWrite)(void);
+
+uint8_t HostWdt;
+uint16_t HostWdtResets;
+
+uint16_t HostFailures;
+
+static uint8_t hostTimer2;
+static uint8_t hostFlags2;
+static uint32_t hostEepromDone;      // HostTicks when the write ends
+/*** END VARIABLES ***/
+
+volatile uint16_t *hostTimer1(volatile uint16_t *reg)
+{
+  if(HostTimer1Access)
+    HostTimer1Access();
+  if(HostInterrupts)
+    HostUnguarded++;
+  if(reg == &HostTCNT1) {
+    HostTCNT1 = HostTicks;
+    HostTicks+= HostTickStep;
+  }
+  return reg;
+}
+
+volatile uint8_t *hostTimer2Count()
+{
+  hostTimer2 = HostTicks >> 3;
+  return &hostTimer2;
+}
+
+volatile uint8_t *hostTimer2Flags()
+{
+  hostFlags2 = 0;
+  return &hostFlags2;
+}
+
+volatile uint8_t *hostAdc()
+{
+  if(HostADCSRA & _BV(ADSC)) {
+    HostADCSRA&= ~_BV(ADSC);
+    ADCW = ADC = HostAdc[ADMUX & 7];
+    HostTicks+= 104 * 8;             // 13 cycles at 125kHz
+  }
+  return &HostADCSRA;
+}
+
+void hostCli()
+{
+  HostInterrupts = false;
+}
+
+void hostSei()
+{
+  HostInterrupts = true;
+  if(HostSei)
+    hostIsr(HostSei);
+}
+
+/*
+ * Run an interrupt handler as the hardware would: with interrupts
+ * disabled until it returns.
+ */
+void hostIsr(void (*isr)(void))
+{
+  bool enabled = HostInterrupts;
+
+  HostInterrupts = false;
+  isr();
+  HostInterrupts = enabled;
+}
+
+void hostSleep()
+{
+  uint8_t us = OCR2A - (uint8_t)(HostTicks >> 3);
+
+  HostTicks+= ((uint16_t)(uint8_t)(us - 1) + 1) << 3;
+}
+
+void hostDelay(double us)
+{
+  HostTicks+= us * 8;
+}
+
+bool hostEepromIdle()
+{
+  return (int32_t)(HostTicks - hostEepromDone) >= 0;
+}
+
+/*
+ * Wait for the write in progress to end, as the EEPROM functions do.
+ */
+void hostEepromWait()
+{
+  int32_t t = hostEepromDone - HostTicks;
+
+  if(t > 0) {
+    HostEepromWaited+= t;
+    HostTicks+= t;
+  }
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+  hostEepromWait();
+  return HostEeprom[(uintptr_t)addr % sizeof(HostEeprom)];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+  hostEepromWait();
+  HostEeprom[(uintptr_t)addr % sizeof(HostEeprom)] = value;
+  HostEepromWrites++;
+  hostEepromDone = HostTicks + 3400 * 8;   // 3.4ms per byte
+  if(HostEepromWrite)
+    HostEepromWrite();
+}
+
+void eeprom_read_block(void *dest, const void *src, size_t size)
+{
+  for(size_t i = 0;i < size;i++)
+    ((uint8_t *)dest)[i] = eeprom_read_byte((const uint8_t *)src + i);
+}
+
+void eeprom_write_block(const void *src, void *dest, size_t size)
+{
+  for(size_t i = 0;i < size;i++)
+    eeprom_write_byte((uint8_t *)dest + i, ((const uint8_t *)src)[i]);
+}
+
+/*
+ * Report and return the exit status for main().
+ */
+int hostDone(const char *test)
+{
+  if(HostFailures) {
+    printf("%s: %u failed\n", test, HostFailures);
+    return 1;
+  }
+  printf("%s: ok\n", test);
+  return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef HOST_H
+#define HOST_H
+
+/*
+ * Host build of the firmware modules, for the tests in test/. The AVR
+ * headers in this directory turn the I/O registers into variables and
+ * model what the firmware depends on:
+ *
+ * timer1 counts HostTicks (8MHz, 1/8 us), and every TCNT1 read moves
+ * time on by HostTickStep, so polling loops end. Access to the 16-bit
+ * timer1 registers with interrupts enabled is counted in
+ * HostUnguarded: on the AVR an interrupt that touches timer1 can
+ * corrupt the shared TEMP register in between the two byte accesses.
+ * HostTimer1Access, if set, runs before every access, which is where
+ * a test sees the compare values the output pins will follow.
+ *
+ * timer2 is timer1 / 8, its compare flag always reads clear and
+ * sleep_cpu() runs the clock to the OCR2A match.
+ *
+ * An ADC conversion ends at the first ADCSRA access after it starts,
+ * 104us later, with HostAdc[] of the ADMUX channel in ADCW.
+ *
+ * sei() calls HostSei, if set, as if a pending interrupt ran.
+ *
+ * hostStep() (step.c) runs a function an instruction at a time and
+ * puts an interrupt in after any one of them, to test code that
+ * shares data with interrupts at every point it can be interrupted.
+ * Stepping is slow (a signal per instruction), so it ends once the
+ * interrupt has gone in. While it steps, it counts the windows with
+ * interrupts disabled and the longest one, in instructions.
+ * The instructions are the host's, not the AVR's: it tests the order
+ * of the C and the barriers in it, not 16-bit accesses tearing, which
+ * HostUnguarded stands for.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*** BEGIN VARIABLES ***/
+extern uint32_t HostTicks;           // timer1 ticks since reset
+extern uint16_t HostTickStep;        // Ticks per TCNT1 read
+extern bool HostInterrupts;          // SREG I flag
+extern uint16_t HostUnguarded;       // timer1 register accesses with I set
+extern void (*HostTimer1Access)(void);  // Before each, e.g. to see OCR1x
+extern void (*HostSei)(void);        // Pending interrupt, run at sei()
+extern uint16_t HostAdc[8];          // ADC inputs
+
+extern uint8_t HostEeprom[1024];
+extern uint16_t HostEepromWrites;
+extern uint32_t HostEepromWaited;    // Ticks waiting for a write to end
+extern void (*HostEepromWrite)(void); // After each byte written
+
+extern uint8_t HostWdt;              // Watchdog timeout + 1, 0 when off
+extern uint16_t HostWdtResets;
+
+extern uint16_t HostFailures;
+
+// Interrupts-off windows in the last hostStep(), in instructions
+extern volatile uint32_t HostMaskedMax;     // Longest
+extern volatile uint32_t HostMaskedWindows;
+/*** END VARIABLES ***/
+
+/*** BEGIN HELPER MACROS ***/
+#define HOST_CHECK(c) do { \
+  if(!(c)) { \
+    HostFailures++; \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); \
+  } \
+} while(0)
+/*** END HELPER MACROS ***/
+
+/*** BEGIN PROTOTYPES ***/
+volatile uint16_t *hostTimer1(volatile uint16_t *reg);
+volatile uint8_t *hostTimer2Count(void);
+volatile uint8_t *hostTimer2Flags(void);
+volatile uint8_t *hostAdc(void);
+void hostCli(void);
+void hostSei(void);
+void hostIsr(void (*isr)(void));
+void hostSleep(void);
+void hostDelay(double us);
+uint32_t hostStep(void (*fn)(void), uint32_t at, void (*isr)(void));
+bool hostStepFired(void);
+int hostDone(const char *test);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Single-stepping for interleaving tests (see hostStep()). Built
+ * without -fpack-struct: struct sigaction and the signal context are
+ * the C library's.
+ */
+#define _GNU_SOURCE
+#include "host.h"
+
+#include <signal.h>
+#include <string.h>
+#include <ucontext.h>
+
+#ifndef __x86_64__
+#error "hostStep() single-steps with the x86-64 trap flag"
+#endif
+
+/*** BEGIN VARIABLES ***/
+static volatile uint32_t hostSteps;
+static volatile uint32_t hostStepAt;
+static void (*volatile hostStepIsr)(void);
+static volatile bool hostStepping;
+static volatile uint32_t hostMasked;  // Steps into the window under way
+
+volatile uint32_t HostMaskedMax;
+volatile uint32_t HostMaskedWindows;
+/*** END VARIABLES ***/
+
+/*
+ * Trap after each instruction. The interrupt goes in at the first
+ * boundary from hostStepAt on where interrupts are enabled, as a
+ * pending one would on the AVR.
+ */
+static void hostTrap(int sig, siginfo_t *info, void *context)
+{
+  ucontext_t *uc = context;
+
+  if(!hostStepping) {
+    uc->uc_mcontext.gregs[REG_EFL]&= ~0x100L;
+    return;
+  }
+  if(!HostInterrupts) {
+    if(!hostMasked++)
+      HostMaskedWindows++;
+    if(hostMasked > HostMaskedMax)
+      HostMaskedMax = hostMasked;
+  } else {
+    hostMasked = 0;
+  }
+  if(hostStepIsr && hostSteps >= hostStepAt && HostInterrupts) {
+    void (*isr)(void) = hostStepIsr;
+
+    // The rest runs at full speed: nothing more to put in
+    hostStepIsr = NULL;
+    hostStepping = false;
+    uc->uc_mcontext.gregs[REG_EFL]&= ~0x100L;
+    hostIsr(isr);
+    return;
+  }
+  hostSteps++;
+}
+
+uint32_t hostStep(void (*fn)(void), uint32_t at, void (*isr)(void))
+{
+  static bool installed;
+
+  if(!installed) {
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = hostTrap;
+    sa.sa_flags = SA_SIGINFO;
+    sigaction(SIGTRAP, &sa, NULL);
+    installed = true;
+  }
+
+  hostSteps = 0;
+  hostMasked = 0;
+  HostMaskedMax = 0;
+  HostMaskedWindows = 0;
+  hostStepAt = at;
+  hostStepIsr = isr;
+  hostStepping = true;
+  asm volatile("pushfq; orq $0x100, (%%rsp); popfq" ::: "memory", "cc");
+  fn();
+  hostStepping = false;
+  asm volatile("nop" ::: "memory");
+  return hostSteps;
+}
+
+/*
+ * Whether the interrupt given to the last hostStep() ran.
+ */
+bool hostStepFired(void)
+{
+  return !hostStepIsr;
+}
@@ -0,0 +1,9 @@
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#include "host.h"
+
+#define _delay_ms(ms) hostDelay((ms) * 1000.0)
+#define _delay_us(us) hostDelay(us)
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Stick-to-pulse latency tracer (latency.c), built with LATENCY_TRACE.
+ *
+ * First a known sequence of captures and pulses, fed to the tracer as
+ * output_motor_ppm() feeds it, across a timer1 wrap: every latency
+ * and the histogram summary latencyStats() makes of it are known,
+ * with a tag replaced before its mix, one held over a frame its
+ * output does not pulse in, one stopped, one dropped for an overrun,
+ * and the decay once a bucket fills.
+ *
+ * Then the real thing: the mixer and output stage of a quad X frame
+ * with captures at known times, against the pin edges themselves,
+ * the off times the frame puts in OCR1B (M1) and OCR1A (M2).
+ */
+#include "latency.h"
+
+#include "mixer.h"
+#include "receiver.h"
+#include "settings.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_FRAME_TICKS ((2000 + PWM_LOW_PULSE_US) << 3)
+#define TEST_START 0xf000            // Sequence frame start, near the wrap
+#define TEST_BEFORE (400 * 8)        // Capture before the frame start
+#define TEST_WIDTH (1100 * 8)        // Pulse, to the falling edge
+#define TEST_LONG (2600 * 8)
+#define TEST_LATENCY ((TEST_BEFORE + TEST_WIDTH) >> 3)  // us, 1500
+#define TEST_HELD (TEST_LATENCY + (TEST_FRAME_TICKS >> 3))
+#define TEST_FRAMES 16               // Stick-moving frames through the stage
+#define TEST_ROLL 0                  // Tracer channels, in Rx order
+#define TEST_PITCH 1
+#define TEST_YAW 3
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What motors.c and mixer.c need from the rest of the firmware
+int16_t RxInRoll, RxInPitch, RxInCollective, RxInYaw, RxInOrgPitch;
+void RxGetChannels(void) { }
+
+static uint16_t testStart;           // Frame start the tracer is at
+static const uint8_t testFeeds[LATENCY_CHANNELS] = { 0, 0, 0, _BV(0) };
+
+static uint16_t testEntry;           // OCR1A, OCR1B on entry (the on time)
+static uint16_t testOff[2];          // First new OCR1B, OCR1A: the off edge
+static uint8_t testSeen;             // Bit per testOff[] found
+/*** END VARIABLES ***/
+
+/*** BEGIN SEQUENCE ***/
+/*
+ * A frame of the sequence: yaw captured `before` the frame start
+ * (none if 0), mixed to M1, which pulses `width` if it is in
+ * `outputs`.
+ */
+static void testFrame(uint16_t before, uint16_t width, uint8_t outputs)
+{
+  if(before)
+    latencyCapture(TEST_YAW, testStart - before);
+  latencyMix(testFeeds);
+  MotorOut[0] = width;
+  MotorStartTCNT1 = testStart + TEST_FRAME_TICKS;
+  latencyPulse(outputs);
+  testStart+= TEST_FRAME_TICKS;
+}
+
+static void testSequence(void)
+{
+  struct latencyStats s;
+
+  testStart = TEST_START;
+  MotorStartTCNT1 = testStart;
+  latencyPulse(0);
+
+  // 10 at 1500us (bucket 5), over the wrap
+  for(uint8_t i = 0;i < 10;i++)
+    testFrame(TEST_BEFORE, TEST_WIDTH, _BV(0));
+  // 3000us (bucket 11)
+  testFrame(TEST_BEFORE, TEST_LONG, _BV(0));
+  // Replaced before the mix: 1500us from the newer one
+  latencyCapture(TEST_YAW, testStart - TEST_BEFORE - TEST_WIDTH);
+  testFrame(TEST_BEFORE, TEST_WIDTH, _BV(0));
+  // Mixed in a frame M1 does not pulse in: a frame more (bucket 14)
+  testFrame(TEST_BEFORE, TEST_WIDTH, 0);
+  testFrame(0, TEST_WIDTH, _BV(0));
+  // Stopped after the mix: none
+  latencyCapture(TEST_YAW, testStart - TEST_BEFORE);
+  latencyMix(testFeeds);
+  latencyStop(_BV(0));
+  testFrame(0, TEST_WIDTH, _BV(0));
+  // After an overrun, and in one: none
+  MotorDeadline.missed = 1;
+  testFrame(TEST_BEFORE, TEST_WIDTH, _BV(0));
+  MotorDeadline.missed = 0;
+  latencyCapture(TEST_YAW, testStart - TEST_BEFORE);
+  MotorDeadline.missed = 1;
+  testFrame(0, TEST_WIDTH, _BV(0));
+  MotorDeadline.missed = 0;
+
+  HOST_CHECK(!latencyStats(TEST_YAW, 1, &s));
+  HOST_CHECK(latencyStats(TEST_YAW, 0, &s));
+  printf("sequence: %u samples, %u..%uus, p50 %uus, p99 %uus\n",
+    s.samples, s.min, s.max, s.p50, s.p99);
+  HOST_CHECK(s.channel == TEST_YAW && s.output == 0);
+  HOST_CHECK(s.samples == 13);
+  HOST_CHECK(s.min == TEST_LATENCY && s.max == TEST_HELD);
+  HOST_CHECK(s.p50 == 6 << LATENCY_BUCKET_SHIFT);
+  HOST_CHECK(s.p99 == TEST_HELD);
+
+  /*
+   * Bucket 5 fills at the 245th more: every bucket halves, the
+   * single ones go; 55 more after that.
+   */
+  for(uint16_t i = 0;i < 300;i++)
+    testFrame(TEST_BEFORE, TEST_WIDTH, _BV(0));
+  HOST_CHECK(latencyStats(TEST_YAW, 0, &s));
+  HOST_CHECK(s.samples == 127 + 56);
+  HOST_CHECK(s.min == TEST_LATENCY && s.max == TEST_HELD);
+  HOST_CHECK(s.p50 == 6 << LATENCY_BUCKET_SHIFT);
+  HOST_CHECK(s.p99 == 6 << LATENCY_BUCKET_SHIFT);
+}
+/*** END SEQUENCE ***/
+
+/*** BEGIN OUTPUT STAGE ***/
+/*
+ * Before every timer1 access in the frame: the first values other
+ * than the on time in OCR1B and OCR1A are their off edges.
+ */
+static void testCompare(void)
+{
+  uint16_t ocr[2] = { HostOCR1B, HostOCR1A };
+
+  for(uint8_t o = 0;o < 2;o++) {
+    if(!(testSeen & _BV(o)) && ocr[o] != testEntry) {
+      testOff[o] = ocr[o];
+      testSeen|= _BV(o);
+    }
+  }
+}
+
+static void testStage(void)
+{
+  struct mixerInput in = { 300, 0, 0, 0 };
+  struct latencyStats s;
+  uint16_t min[2] = { UINT16_MAX, UINT16_MAX }, max[2] = { 0, 0 };
+
+  HostTickStep = 8;
+  Set_EEPROM_Default_Config();
+  Config.FrameType = FRAME_QUAD_X;
+  motorsSetup();
+  mixerSetup();
+  sei();
+  for(uint8_t i = 0;i < 4;i++) {
+    mixerMix(&in);
+    output_motor_ppm();
+  }
+
+  for(uint8_t i = 0;i < TEST_FRAMES;i++) {
+    uint16_t capture = MotorStartTCNT1 - (i * 150 - 900) * 8;
+
+    latencyCapture(TEST_ROLL, capture);
+    in.roll = i * 40 - 300;
+    mixerMix(&in);
+
+    testEntry = MotorStartTCNT1;
+    testSeen = 0;
+    HostTimer1Access = testCompare;
+    output_motor_ppm();
+    HostTimer1Access = NULL;
+    HOST_CHECK(testSeen == 3);
+
+    for(uint8_t o = 0;o < 2;o++) {
+      uint16_t us = (uint16_t)(testOff[o] - capture) >> 3;
+
+      if(us < min[o])
+        min[o] = us;
+      if(us > max[o])
+        max[o] = us;
+    }
+  }
+  HOST_CHECK(MotorDeadline.overruns == 0);
+
+  for(uint8_t o = 0;o < 2;o++) {
+    HOST_CHECK(latencyStats(TEST_ROLL, o, &s));
+    printf("M%u: %u..%uus at the pin, %u..%uus traced\n",
+      o + 1, min[o], max[o], s.min, s.max);
+    HOST_CHECK(s.samples == TEST_FRAMES);
+    HOST_CHECK(s.min == min[o] && s.max == max[o]);
+  }
+  HOST_CHECK(!latencyStats(TEST_PITCH, 0, &s));
+}
+/*** END OUTPUT STAGE ***/
+
+int main(void)
+{
+  testSequence();
+  testStage();
+  return hostDone("latency");
+}
@@ -0,0 +1,344 @@
+/*
+ * Output stage (output_motor_ppm() in motors.c) against an Rx pin
+ * interrupt at every point it can be interrupted, stepped as in
+ * snapshot_test.c. timer1 must only be touched with interrupts off,
+ * and the later the interrupt goes in, the further on it must find
+ * OCR1B and OCR1A, one at a time: at the on time the frame was
+ * entered with, then at the off time of their output, then at the
+ * next on time.
+ *
+ * A frame is some thousands of host instructions, too many to step
+ * each run to: runs go in every TEST_STRIDE instructions, and at
+ * every instruction where the registers changed in between.
+ *
+ * Then the software pins of an eight-output frame: how late their
+ * edges are made (MotorSoftLateMax) with a pass of the wait loop
+ * taking TEST_POLL_TICKS, with no interrupt and with one of
+ * TEST_ISR_TICKS in the frame; and how often, and for how long, a
+ * frame holds interrupts off, which is what it adds to Rx interrupt
+ * latency.
+ *
+ * Then a config save: the ESCs must get their stopped frames all
+ * through it, one or two between EEPROM bytes, and none late.
+ *
+ * Last, motor identification stepping the frame with the roll stick:
+ * outputs that become servos must stay at ESC zero until yaw
+ * confirms, as an ESC of the old frame may be on them.
+ */
+#include "motors.h"
+
+#include <setjmp.h>
+#include <string.h>
+
+#include "mixer.h"
+#include "receiver.h"
+#include "settings.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_FRAMES 4
+#define TEST_OUT0 300                 // M1 (OC1B)
+#define TEST_OUT1 700                 // M2 (OC1A)
+#define TEST_STRIDE 64
+#define TEST_POLL_TICKS 20           // Wait loop pass, cycles (= ticks)
+#define TEST_ISR_TICKS (10 * 8)      // A serial Rx byte, about
+#define TEST_FRAME_TICKS ((2000 + PWM_LOW_PULSE_US) << 3)
+#define TEST_GESTURE 8               // Frames per identification gesture
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What motors.c and mixer.c need from the rest of the firmware
+int16_t RxInRoll, RxInPitch, RxInCollective, RxInYaw, RxInOrgPitch;
+static void (*testRx)(void);         // Sticks, for motorsIdentify()
+void RxGetChannels(void)
+{
+  if(testRx)
+    testRx();
+}
+
+static uint16_t testStart;           // MotorStartTCNT1 on entry
+static uint16_t testOff[2];          // OCR1B, OCR1A off times
+static uint16_t testRise, testWidth; // The pulse the interrupt times
+static uint8_t testSeen;             // What the interrupt found, see testEdge()
+static uint8_t testFound;            // Bit per testSeen value
+static uint16_t testUnguarded;       // HostUnguarded before the frame
+static uint32_t testRuns;
+static uint16_t testSaveFrame;       // MotorStartTCNT1 at the last byte
+static uint16_t testSaveResets;      // HostWdtResets at the last byte
+static jmp_buf testIdentifyEnd;
+static uint16_t testIdentifyFrame;
+
+/*
+ * Identification gestures, TEST_GESTURE frames each (half held, half
+ * centred): the frame and whether servos are at their stop values
+ * after it. Within the ESC init time, so nothing spins.
+ */
+static const struct {
+  int16_t roll, yaw;
+  uint8_t frame;
+  bool servos;
+} testGesture[] = {
+  { 0, 0, FRAME_QUAD_X, true },
+  { -2 * STICK_THROW, 0, FRAME_QUAD, false },
+  { -2 * STICK_THROW, 0, FRAME_TRI, false },   // M4 a servo
+  { 0, 2 * STICK_THROW, FRAME_TRI, true },
+  { -2 * STICK_THROW, 0, FRAME_TWIN, false },  // M3..M6 servos
+};
+
+// Octo outputs: M3 and M4 (PB0, PD7) apart, M7 and M8 (PB3, PB4) together
+static const int16_t testOcto[8] = { 100, 200, 350, 600, 300, 400, 800, 800 };
+/*** END VARIABLES ***/
+
+/*
+ * An Rx pin edge, as the PWM interrupts take it: a TCNT1 read. Also
+ * looks at the compare registers: 0 both at the on time, 1 OCR1B
+ * off, 2 both off, 3 OCR1B at the next on time, 4 both; 0xff for
+ * anything else.
+ */
+static void testEdge(void)
+{
+  uint16_t b = HostOCR1B, a = HostOCR1A;
+  uint16_t next = MotorStartTCNT1;
+
+  testWidth = TCNT1 - testRise;
+  if(b == testStart && a == testStart)
+    testSeen = 0;
+  else if(b == testOff[0] && a == testStart)
+    testSeen = 1;
+  else if(b == testOff[0] && a == testOff[1])
+    testSeen = 2;
+  else if(b == next && a == testOff[1])
+    testSeen = 3;
+  else if(b == next && a == next)
+    testSeen = 4;
+  else
+    testSeen = 0xff;
+}
+
+/*
+ * Outputs for a frame; the off times follow the clamp and the
+ * conversion to ticks output_motor_ppm() makes.
+ */
+static void testOutputs(void)
+{
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++)
+    MotorOut[i] = 0;
+  MotorOut[0] = TEST_OUT0;
+  MotorOut[1] = TEST_OUT1;
+  testStart = MotorStartTCNT1;
+  testOff[0] = testStart + ((TEST_OUT0 + MIXER_BASE(Mixer.output[0].flags)) << 3);
+  testOff[1] = testStart + ((TEST_OUT1 + MIXER_BASE(Mixer.output[1].flags)) << 3);
+  testUnguarded = HostUnguarded;
+}
+
+/*
+ * A frame with the interrupt at `at`: what it found. The frame must
+ * leave both compare registers at the next on time, with no
+ * unguarded timer1 access.
+ */
+static uint8_t testRun(uint32_t at)
+{
+  testOutputs();
+  testSeen = 0xfe;
+  hostStep(output_motor_ppm, at, testEdge);
+  if(!hostStepFired())
+    hostIsr(testEdge);
+  testRuns++;
+
+  HOST_CHECK(testSeen <= 4);
+  HOST_CHECK(HostUnguarded == testUnguarded);
+  HOST_CHECK(HostOCR1B == (uint16_t)MotorStartTCNT1);
+  HOST_CHECK(HostOCR1A == (uint16_t)MotorStartTCNT1);
+  HOST_CHECK((uint16_t)(MotorStartTCNT1 - testStart) ==
+    (2000 + PWM_LOW_PULSE_US) << 3);
+  testFound|= _BV(testSeen & 7);
+  return testSeen;
+}
+
+/*
+ * An interrupt that takes TEST_ISR_TICKS.
+ */
+static void testBusy(void)
+{
+  HostTicks+= TEST_ISR_TICKS;
+}
+
+/*
+ * Worst software edge over a frame with testBusy() in at every
+ * TEST_STRIDE instructions, or nowhere (isr NULL).
+ */
+static uint16_t testLate(void (*isr)(void))
+{
+  uint32_t steps;
+  uint16_t late = 0;
+
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++)
+    MotorOut[i] = testOcto[i];
+  steps = hostStep(output_motor_ppm, UINT32_MAX, NULL);
+  for(uint32_t at = 0;at <= steps;at+= isr ? TEST_STRIDE : steps + 1) {
+    for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++)
+      MotorOut[i] = testOcto[i];
+    MotorSoftLateMax = 0;
+    if(isr)
+      hostStep(output_motor_ppm, at, isr);
+    else
+      output_motor_ppm();
+    if(MotorSoftLateMax > late)
+      late = MotorSoftLateMax;
+  }
+  return late;
+}
+
+static void testJitter(void)
+{
+  uint16_t quiet, busy;
+  uint32_t windows, longest;
+
+  HostTickStep = TEST_POLL_TICKS;
+  Config.FrameType = FRAME_OCTO;
+  mixerSetup();
+  HOST_CHECK(Mixer.outputs == 8);
+
+  quiet = testLate(NULL);
+  busy = testLate(testBusy);
+  printf("software edges late by %u ticks, %u with a %u-tick interrupt\n",
+    quiet, busy, TEST_ISR_TICKS);
+  HOST_CHECK(quiet < TEST_POLL_TICKS);
+  HOST_CHECK(busy < TEST_POLL_TICKS + TEST_ISR_TICKS);
+  HOST_CHECK(busy > quiet);
+  HOST_CHECK(MotorDeadline.overruns == 0);
+
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++)
+    MotorOut[i] = testOcto[i];
+  hostStep(output_motor_ppm, UINT32_MAX, NULL);
+  windows = HostMaskedWindows;
+  longest = HostMaskedMax;
+  printf("interrupts off %u times a frame, for at most %u instructions\n",
+    windows, longest);
+  HOST_CHECK(windows < 64);
+  HOST_CHECK(longest < 32);
+}
+
+/*
+ * An EEPROM byte written: the frames since the last one.
+ */
+static void testSaveWrite(void)
+{
+  uint16_t frames = (uint16_t)(MotorStartTCNT1 - testSaveFrame) / TEST_FRAME_TICKS;
+
+  if(HostEepromWrites > 1) {
+    HOST_CHECK(frames >= 1 && frames <= 2);
+    HOST_CHECK(HostWdtResets - testSaveResets >= frames);
+  }
+  testSaveFrame = MotorStartTCNT1;
+  testSaveResets = HostWdtResets;
+}
+
+static void testSave(void)
+{
+  uint32_t start = HostTicks;
+
+  for(uint8_t i = 0;i < sizeof(Config);i++)
+    HostEeprom[EEPROM_DATA_START_POS + i] = ~((uint8_t *)&Config)[i];
+  HostEepromWrites = 0;
+  HostEepromWaited = 0;
+  HostEepromWrite = testSaveWrite;
+  Save_Config_to_EEPROM();
+  HostEepromWrite = NULL;
+
+  printf("config save: %u bytes in %.0fms, no waits without frames\n",
+    HostEepromWrites, (HostTicks - start) / 8000.0);
+  HOST_CHECK(HostEepromWrites == sizeof(Config));
+  HOST_CHECK(HostEepromWaited == 0);
+  HOST_CHECK(!memcmp(&HostEeprom[EEPROM_DATA_START_POS], &Config, sizeof(Config)));
+  HOST_CHECK(MotorDeadline.overruns == 0);
+}
+
+/*
+ * The sticks for motorsIdentify(); at the end of each gesture, checks
+ * the outputs of the frame just made (converted to ticks).
+ */
+static void testIdentifyRx(void)
+{
+  uint16_t g = testIdentifyFrame / TEST_GESTURE;
+  uint8_t f = testIdentifyFrame++ % TEST_GESTURE;
+
+  if(f == TEST_GESTURE - 1) {
+    HOST_CHECK(Config.FrameType == testGesture[g].frame);
+    for(uint8_t i = 0;i < Mixer.outputs;i++) {
+      int16_t out = 0;
+
+      if(!(Mixer.output[i].flags & MIXER_MOTOR) && testGesture[g].servos)
+        out = Mixer.output[i].stop;
+      HOST_CHECK(MotorOut[i] == (out + MIXER_BASE(Mixer.output[i].flags)) << 3);
+    }
+  }
+  if(g + 1 >= sizeof(testGesture) / sizeof(testGesture[0]) && f == TEST_GESTURE - 1)
+    longjmp(testIdentifyEnd, 1);
+  g+= f == TEST_GESTURE - 1;
+  RxInRoll = f < TEST_GESTURE / 2 ? testGesture[g].roll : 0;
+  RxInYaw = f < TEST_GESTURE / 2 ? testGesture[g].yaw : 0;
+}
+
+static void testIdentify(void)
+{
+  Config.FrameType = FRAME_QUAD_X;
+  mixerSetup();
+  testIdentifyFrame = 0;
+  RxInRoll = RxInYaw = 0;
+  testRx = testIdentifyRx;
+  if(!setjmp(testIdentifyEnd))
+    motorsIdentify();
+  testRx = NULL;
+  HOST_CHECK(testIdentifyFrame == sizeof(testGesture) / sizeof(testGesture[0]) * TEST_GESTURE);
+  HOST_CHECK(Config.FrameType == FRAME_TWIN);
+}
+
+int main(void)
+{
+  uint32_t steps;
+  uint8_t last, seen;
+
+  HostTickStep = 8;                  // A poll of TCNT1 is about 1us
+  Set_EEPROM_Default_Config();
+  Config.FrameType = FRAME_QUAD_X;
+  motorsSetup();
+  mixerSetup();
+  sei();
+
+  // Settle: the first frame starts from wherever timer1 is
+  for(uint8_t i = 0;i < TEST_FRAMES;i++) {
+    testOutputs();
+    output_motor_ppm();
+  }
+
+  testOutputs();
+  steps = hostStep(output_motor_ppm, UINT32_MAX, NULL);
+  HOST_CHECK(steps > 100);
+
+  last = testRun(0);
+  HOST_CHECK(last == 0);
+  for(uint32_t at = TEST_STRIDE;at < steps + TEST_STRIDE;at+= TEST_STRIDE) {
+    seen = testRun(at);
+    HOST_CHECK(seen >= last);
+    if(seen != last) {
+      for(uint32_t i = at - TEST_STRIDE + 1;i < at;i++) {
+        uint8_t s = testRun(i);
+
+        HOST_CHECK(s == last || s == last + 1);
+        last = s;
+      }
+      HOST_CHECK(seen == last || seen == last + 1);
+    }
+    last = seen;
+  }
+  HOST_CHECK(last == 4);
+  HOST_CHECK(testFound == 0x1f);     // Every state, one write at a time
+  HOST_CHECK(MotorDeadline.overruns == 0);
+
+  printf("%u boundaries, %u runs\n", steps, testRuns);
+
+  testJitter();
+  testSave();
+  testIdentify();
+  return hostDone("motors");
+}
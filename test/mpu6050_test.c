@@ -0,0 +1,318 @@
+/*
+ * MPU-6050 driver (mpu6050.c) and gyro calibration against a simulated
+ * sensor: a model of the TWI unit and the device registers, run as
+ * the pending interrupt at every sei() (see host.h), with a
+ * data-ready pulse every 2ms. Checks the setup writes, the burst
+ * reads, the calibration, that a missing, silent or hung sensor
+ * ends the waits in time with MpuErrors counted, and that one going
+ * silent in flight is given up after MPU_STALE_LOOPS loops.
+ */
+#include "mpu6050.h"
+
+#include <string.h>
+#include <util/twi.h>
+
+#include "gyros.h"
+#include "receiver.h"
+#include "settings.h"
+
+void TWI_vect(void);
+void PCINT1_vect(void);
+
+/*** BEGIN DEFINES ***/
+#define TEST_BYTE_TICKS (45 * 8)     // 9 bits at 200kHz
+#define TEST_SAMPLE_TICKS (2000 * 8) // 500Hz data-ready
+#define TEST_WAIT_TICKS ((MPU_WAIT_US + 200) * 8L)  // With an ADC read
+#define TEST_LOOP_TICKS (2222 * 8)   // A loop at ESC_RATE
+#define TEST_LOOPS 50
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What gyros.c needs from the rest of the firmware
+struct config Config;
+int16_t RxInRoll, RxInPitch, RxInYaw;
+void motorsStopFrame(void) { }
+void RxGetChannels(void) { }
+void Save_Config_to_EEPROM(void) { }
+
+static const int16_t testGyro[3] = { 1200, -3400, 560 };
+static const int16_t testAcc[3] = { 100, -200, MPU_ACC_1G };
+
+static struct {
+  bool present;                      // Answers its address
+  bool hung;                         // Holds the bus: no TWI events
+  bool sampling;                     // Makes data-ready pulses
+  uint8_t reg[128];
+  uint8_t pointer;                   // Register address
+  bool first;                        // Next byte written is the address
+  bool owned;                        // Bus not released since a start
+  bool busy;                         // TWI action under way
+  uint32_t busTime;                  // When it completes
+  uint32_t sampleTime;               // Next data-ready
+  uint16_t samples;
+} testMpu;
+/*** END VARIABLES ***/
+
+static void testPut(uint8_t reg, int16_t v)
+{
+  testMpu.reg[reg] = v >> 8;
+  testMpu.reg[reg + 1] = v;
+}
+
+/*
+ * New sample registers: the gyro goes +-3 around testGyro[] every
+ * other sample.
+ */
+static void testSample(void)
+{
+  int16_t noise = testMpu.samples & 1 ? 3 : -3;
+
+  for(uint8_t i = 0;i < 3;i++) {
+    testPut(MPU_REG_ACCEL_XOUT_H + i * 2, testAcc[i]);
+    testPut(MPU_REG_ACCEL_XOUT_H + 8 + i * 2, testGyro[i] + noise);
+  }
+  testMpu.samples++;
+}
+
+/*
+ * The TWI unit finishing the action TWCR started (TWINT written).
+ */
+static void testTwi(uint8_t c)
+{
+  uint8_t status = TW_BUS_ERROR;
+
+  if(c & _BV(TWSTO)) {
+    testMpu.owned = false;
+    TWCR&= ~_BV(TWSTO);
+    return;
+  }
+  if(c & _BV(TWSTA)) {
+    status = testMpu.owned ? TW_REP_START : TW_START;
+    testMpu.owned = true;
+  } else {
+    switch(TWSR) {
+    case TW_START:
+    case TW_REP_START:
+      if(!testMpu.present || TWDR >> 1 != MPU_ADDRESS) {
+        status = TWDR & TW_READ ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+      } else if(TWDR & TW_READ) {
+        status = TW_MR_SLA_ACK;
+      } else {
+        status = TW_MT_SLA_ACK;
+        testMpu.first = true;
+      }
+      break;
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if(testMpu.first)
+        testMpu.pointer = TWDR;
+      else
+        testMpu.reg[testMpu.pointer++ & 0x7f] = TWDR;
+      testMpu.first = false;
+      status = TW_MT_DATA_ACK;
+      break;
+    case TW_MR_SLA_ACK:
+    case TW_MR_DATA_ACK:
+      TWDR = testMpu.reg[testMpu.pointer++ & 0x7f];
+      status = c & _BV(TWEA) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+      break;
+    }
+  }
+  TWSR = status;
+  if(c & _BV(TWIE))
+    TWI_vect();
+}
+
+/*
+ * Pending interrupts: data-ready and TWI events that are due.
+ */
+static void testBus(void)
+{
+  if(testMpu.sampling && (int32_t)(HostTicks - testMpu.sampleTime) >= 0) {
+    testMpu.sampleTime+= TEST_SAMPLE_TICKS;
+    if(testMpu.reg[MPU_REG_INT_ENABLE] & 0x01) {
+      testSample();
+      PINC|= _BV(0);
+      if((PCICR & _BV(PCIE1)) && (PCMSK1 & _BV(PCINT8)))
+        PCINT1_vect();
+      PINC&= ~_BV(0);                // 50us pulse
+    }
+  }
+
+  if(testMpu.hung || !(TWCR & _BV(TWINT)))
+    return;
+  if(!testMpu.busy) {
+    testMpu.busy = true;
+    testMpu.busTime = HostTicks + TEST_BYTE_TICKS;
+  } else if((int32_t)(HostTicks - testMpu.busTime) >= 0) {
+    uint8_t c = TWCR;
+
+    testMpu.busy = false;
+    TWCR = c & ~_BV(TWINT);
+    testTwi(c);
+  }
+}
+
+static void testReset(bool present, bool hung, bool sampling)
+{
+  memset(&testMpu, 0, sizeof(testMpu));
+  testMpu.present = present;
+  testMpu.hung = hung;
+  testMpu.sampling = sampling;
+  testMpu.sampleTime = HostTicks + TEST_SAMPLE_TICKS;
+  TWCR = 0;
+  TWSR = 0;
+  PCICR = 0;
+  MpuErrors = 0;
+}
+
+static void testSetup(void)
+{
+  uint32_t start = HostTicks;
+
+  testReset(true, false, true);
+  mpuSetup();
+  HOST_CHECK(MpuErrors == 0);
+  HOST_CHECK(testMpu.reg[MPU_REG_PWR_MGMT_1] == 0x01);
+  HOST_CHECK(testMpu.reg[MPU_REG_SMPLRT_DIV] == MPU_SMPLRT_DIV);
+  HOST_CHECK(testMpu.reg[MPU_REG_CONFIG] == MPU_DLPF);
+  HOST_CHECK(testMpu.reg[MPU_REG_GYRO_CONFIG] == MPU_GYRO_FS);
+  HOST_CHECK(testMpu.reg[MPU_REG_ACCEL_CONFIG] == MPU_ACCEL_FS);
+  HOST_CHECK(testMpu.reg[MPU_REG_INT_PIN_CFG] == 0x10);
+  HOST_CHECK(testMpu.reg[MPU_REG_INT_ENABLE] == 0x01);
+  HOST_CHECK(!testMpu.owned);
+  HOST_CHECK(HostTicks - start < 7 * 5 * TEST_BYTE_TICKS * 2);
+}
+
+/*
+ * 16 samples at 500Hz; the bias is the mean, and later samples come
+ * out less the bias.
+ */
+static void testCalibrate(void)
+{
+  uint32_t start = HostTicks;
+  uint8_t samples;
+
+  HOST_CHECK(CalibrateGyros());
+  HOST_CHECK(MpuErrors == 0);
+  HOST_CHECK(HostTicks - start >= 15 * TEST_SAMPLE_TICKS);
+  HOST_CHECK(HostTicks - start <= 17 * TEST_SAMPLE_TICKS);
+
+  samples = MpuSamples;
+  HOST_CHECK(mpuWaitSample());
+  HOST_CHECK(MpuSamples == (uint8_t)(samples + 1));
+  ReadGyros();
+  for(uint8_t i = 0;i < 3;i++) {
+    int16_t noise = (testMpu.samples - 1) & 1 ? 3 : -3;
+
+    HOST_CHECK(MpuAcc[i] == testAcc[i]);
+    HOST_CHECK(MpuGyro[i] == testGyro[i] + noise);
+    HOST_CHECK(gyroRate[i] == noise);
+    HOST_CHECK(gyroZero[i] == 0);
+  }
+}
+
+/*
+ * One loop: the time it takes, with the sensor interrupts running,
+ * then what loopInputs() does with the gyro.
+ */
+static bool testLoop(void)
+{
+  uint32_t end = HostTicks + TEST_LOOP_TICKS;
+
+  while((int32_t)(HostTicks - end) < 0) {
+    cli();
+    (void)TCNT1;
+    sei();
+  }
+  ReadGyros();
+  return mpuStalled();
+}
+
+/*
+ * Loops with samples coming: no errors. With none: every loop is
+ * counted, and the MPU_STALE_LOOPS-th and later give the sensor up,
+ * until a sample comes again.
+ */
+static void testStall(void)
+{
+  uint16_t errors;
+
+  testLoop();
+  errors = MpuErrors;
+  for(uint8_t i = 0;i < TEST_LOOPS;i++)
+    HOST_CHECK(!testLoop());
+  HOST_CHECK(MpuErrors == errors);
+
+  testMpu.sampling = false;
+  testLoop();                        // The sample under way, if any
+  errors = MpuErrors;
+  for(uint8_t i = 1;i <= MPU_STALE_LOOPS + 2;i++) {
+    HOST_CHECK(testLoop() == (i >= MPU_STALE_LOOPS));
+    HOST_CHECK(MpuErrors == errors + i);
+  }
+
+  testMpu.sampling = true;
+  testMpu.sampleTime = HostTicks;
+  HOST_CHECK(!testLoop());
+  HOST_CHECK(!testLoop());
+  HOST_CHECK(MpuErrors == errors + MPU_STALE_LOOPS + 2);
+}
+
+/*
+ * No more samples: the calibration gives up after MPU_WAIT_US, which
+ * leaves the copter disarmed (see loopInputs()).
+ */
+static void testSilent(void)
+{
+  uint32_t start;
+
+  testMpu.sampling = false;
+  start = HostTicks;
+  HOST_CHECK(!CalibrateGyros());
+  HOST_CHECK(MpuErrors == 1);
+  HOST_CHECK(HostTicks - start <= TEST_WAIT_TICKS);
+
+  testMpu.sampling = true;
+  testMpu.sampleTime = HostTicks + TEST_SAMPLE_TICKS;
+  HOST_CHECK(CalibrateGyros());
+  HOST_CHECK(MpuErrors == 1);
+}
+
+/*
+ * Nothing on the bus: every write is refused at once. A hung bus
+ * (no TWI events at all) times out every write.
+ */
+static void testMissing(void)
+{
+  uint32_t start;
+
+  testReset(false, false, false);
+  start = HostTicks;
+  mpuSetup();
+  HOST_CHECK(MpuErrors == 7);
+  HOST_CHECK(HostTicks - start < 7 * 5 * TEST_BYTE_TICKS * 2);
+  HOST_CHECK(!CalibrateGyros());
+  HOST_CHECK(MpuErrors == 8);
+
+  testReset(true, true, false);
+  start = HostTicks;
+  mpuSetup();
+  HOST_CHECK(MpuErrors == 7);
+  HOST_CHECK(HostTicks - start <= 7 * TEST_WAIT_TICKS);
+  HOST_CHECK(!CalibrateGyros());
+  HOST_CHECK(MpuErrors == 8);
+}
+
+int main(void)
+{
+  HostSei = testBus;
+  sei();
+  testSetup();
+  testCalibrate();
+  testSilent();
+  testStall();
+  testMissing();
+  HOST_CHECK(HostUnguarded == 0);
+  return hostDone("mpu6050");
+}
@@ -0,0 +1,106 @@
+/*
+ * Gyro notch (notch.c): the throttle map, clamped to NOTCH_F_MIN..
+ * NOTCH_F_MAX at every point, and the filter it tunes: unity at DC,
+ * a deep notch at the centre.
+ */
+#include "notch.h"
+
+#include <math.h>
+
+#include "gyros.h"
+#include "motors.h"
+#include "settings.h"
+
+/*** BEGIN VARIABLES ***/
+struct config Config;
+/*** END VARIABLES ***/
+
+/*
+ * Centre frequency for a collective, once the retune has run.
+ */
+static uint8_t testTune(int16_t collective)
+{
+  notchReset();
+  for(uint8_t i = 0;i < 4;i++)
+    notchUpdate(collective);
+  return NotchFreq;
+}
+
+static void testMap(const uint8_t *map)
+{
+  for(uint8_t i = 0;i < NOTCH_POINTS;i++)
+    Config.NotchFreq[i] = map[i];
+}
+
+static void testMaps(void)
+{
+  static const uint8_t off[] = { 0, 0, 0, 0, 0 };
+  static const uint8_t ramp[] = { 60, 80, 100, 120, 140 };
+  static const uint8_t wide[] = { 10, 20, 100, 200, 250 };
+  static const uint8_t gap[] = { 60, 0, 100, 120, 0 };
+
+  testMap(off);
+  HOST_CHECK(testTune(0) == 0);
+  HOST_CHECK(testTune(1000) == 0);
+
+  testMap(ramp);
+  HOST_CHECK(testTune(-50) == 60);
+  HOST_CHECK(testTune(128) == 70);
+  HOST_CHECK(testTune(512) == 100);
+  HOST_CHECK(testTune(1000) == 138);
+  HOST_CHECK(testTune(1024) == 140);
+  HOST_CHECK(testTune(2000) == 140);
+
+  // Every point, the last one too, is clamped
+  testMap(wide);
+  HOST_CHECK(testTune(0) == NOTCH_F_MIN);
+  HOST_CHECK(testTune(260) == NOTCH_F_MIN);
+  HOST_CHECK(testTune(768) == 200);
+  HOST_CHECK(testTune(1000) == NOTCH_F_MAX);
+  HOST_CHECK(testTune(1024) == NOTCH_F_MAX);
+  HOST_CHECK(testTune(1500) == NOTCH_F_MAX);
+
+  // A 0 point turns the notch off on both sides
+  testMap(gap);
+  HOST_CHECK(testTune(100) == 0);
+  HOST_CHECK(testTune(300) == 0);
+  HOST_CHECK(testTune(600) == 106);
+  HOST_CHECK(testTune(900) == 0);
+  HOST_CHECK(testTune(1024) == 0);
+}
+
+/*
+ * Peak output over the last half of 400 samples of a sine at `hz`.
+ */
+static int16_t testPeak(double hz, int16_t dc, int16_t amplitude)
+{
+  int16_t peak = 0;
+
+  for(uint16_t i = 0;i < 400;i++) {
+    int16_t x = dc + amplitude * sin(2 * M_PI * hz * i / ESC_RATE);
+    int16_t y = notchApply(ROLL, x);
+
+    if(i >= 200 && abs(y) > peak)
+      peak = abs(y);
+  }
+  return peak;
+}
+
+static void testFilter(void)
+{
+  static const uint8_t flat[] = { 100, 100, 100, 100, 100 };
+
+  testMap(flat);
+  HOST_CHECK(testTune(500) == 100);
+  HOST_CHECK(abs(testPeak(0, 1000, 0) - 1000) <= 2);
+  HOST_CHECK(testPeak(100, 0, 1000) < 50);
+  HOST_CHECK(testPeak(20, 0, 1000) > 900);
+  HOST_CHECK(testPeak(180, 0, 1000) > 800);
+}
+
+int main(void)
+{
+  testMaps();
+  testFilter();
+  return hostDone("notch");
+}
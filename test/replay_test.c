@@ -0,0 +1,335 @@
+/*
+ * Capture replay (capture.h): a capture, the telemetry record stream
+ * as a logger on TXD keeps it, is run through loopCompute() (loop.c)
+ * the way the firmware ran it, and MotorOut[] is checked frame by
+ * frame against the outputs of the flight.
+ *
+ * captures/ holds a capture per gyro build (TEST_FIXTURE.cap) and the
+ * outputs it gave (.out, one line per frame). They come from a
+ * synthetic flight made here with the firmware's own capture code:
+ * "make fixtures" writes them again, which is only right when a
+ * change is meant to change the outputs. Every run also records that
+ * flight in memory and replays it, to check the record format both
+ * ways.
+ */
+#include "capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "loop.h"
+#include "mixer.h"
+#include "notch.h"
+#include "sticks.h"
+#include "tpa.h"
+#ifdef GYRO_MPU6050
+#include "attitude.h"
+#endif
+
+/*** BEGIN DEFINES ***/
+#ifdef GYRO_MPU6050
+#define TEST_NAME "replay MPU-6050"
+#define TEST_FIXTURE "captures/mpu6050"
+#define TEST_FRAME_TYPE FRAME_QUAD_X
+#else
+#define TEST_NAME "replay"
+#define TEST_FIXTURE "captures/analog"
+#define TEST_FRAME_TYPE FRAME_TRI
+#endif
+
+#define TEST_FRAMES (4 * ESC_RATE)
+#define TEST_STREAM 65536
+#define TEST_LINE 64                 // Output text per frame, at most
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What the modules under test need from the rest of the firmware
+int16_t RxInRoll, RxInPitch, RxInCollective, RxInYaw, RxInOrgPitch;
+uint16_t TelemetryDropped;
+void RxGetChannels(void) { }
+void telemetryFlush(void) { }
+
+static uint8_t testStream[TEST_STREAM];  // Telemetry records
+static size_t testStreamLength;
+/*** END VARIABLES ***/
+
+/*
+ * The telemetry link, framed as telemetrySend() frames it (see
+ * telemetry.h).
+ */
+bool telemetrySend(uint8_t type, const void *data, uint8_t length)
+{
+  const uint8_t *p = data;
+  uint8_t sum = type + length;
+
+  if(testStreamLength + length + 4 > TEST_STREAM) {
+    TelemetryDropped++;
+    return false;
+  }
+  testStream[testStreamLength++] = TELEMETRY_SYNC;
+  testStream[testStreamLength++] = type;
+  testStream[testStreamLength++] = length;
+  for(uint8_t i = 0;i < length;i++) {
+    sum+= p[i];
+    testStream[testStreamLength++] = p[i];
+  }
+  testStream[testStreamLength++] = sum;
+  return true;
+}
+
+/*
+ * One frame's outputs, as a line of text.
+ */
+static size_t testOutputs(char *text)
+{
+  size_t n = 0;
+
+  for(uint8_t i = 0;i < MOTOR_OUTPUTS;i++)
+    n+= sprintf(text + n, i ? " %d" : "%d", MotorOut[i]);
+  text[n++] = '\n';
+  return n;
+}
+
+/*** BEGIN FLIGHT ***/
+static uint16_t testRandom(void)
+{
+  static uint32_t seed = 12345;
+
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+/*
+ * What loopInputs() does on arming, after the setup and gain pots.
+ */
+static void testArm(void)
+{
+  Set_EEPROM_Default_Config();
+  Config.setup = SETTINGS_VERSION;
+  Config.layout = SETTINGS_LAYOUT;
+  Config.FrameType = TEST_FRAME_TYPE;
+  Config.NotchFreq[2] = 150;         // Some notch from half throttle
+  Config.NotchFreq[3] = 170;
+  Config.NotchFreq[4] = 190;
+  mixerSetup();
+
+  GainPotADC[ROLL] = GainInADC[ROLL] = 320;
+  GainPotADC[PITCH] = GainInADC[PITCH] = 300;
+  GainPotADC[YAW] = GainInADC[YAW] = 410;
+
+#ifdef GYRO_MPU6050
+  AttAngle[ROLL] = 3 * ATT_UNITS_PER_DEG;
+  AttAngle[PITCH] = -2 * ATT_UNITS_PER_DEG;
+#endif
+  sticksBuildCurves();
+  tpaBuildTable();
+  loopReset();
+  captureStart();
+}
+
+/*
+ * Four seconds: arm, throttle up, a stick step per axis in turn,
+ * then (MPU-6050) self-level and a sudden angle change, and disarm.
+ * The gyros follow the stabilizer output through a first-order
+ * plant, with noise. Appends the outputs to `text`.
+ */
+static size_t testFly(char *text)
+{
+  int16_t rate[3] = { 0, 0, 0 };
+  size_t n = 0;
+
+  testStreamLength = 0;
+  testArm();
+
+  for(uint16_t f = 0;f < TEST_FRAMES;f++) {
+    int16_t out[3];
+
+    Armed = f < TEST_FRAMES - 1;
+    RxInCollective = f < ESC_RATE ? (int32_t)f * 600 / ESC_RATE :
+      600 + (int16_t)(testRandom() & 31) - 16;
+    RxInRoll = f >= 500 && f < 600 ? 400 : 0;
+    RxInPitch = f >= 700 && f < 800 ? -300 : 0;
+    RxInYaw = f >= 900 && f < 1000 ? 500 : 0;
+    RxInOrgPitch = RxInPitch >> 1;
+    for(uint8_t i = ROLL;i <= YAW;i++)
+      gyroADC[i] = rate[i] + (int16_t)(testRandom() & 3) - 2;
+#ifdef GYRO_MPU6050
+    AttLevel = f >= 1100;
+    AttAngle[ROLL]+= rate[ROLL] * 2;
+    AttAngle[PITCH]+= rate[PITCH] * 2;
+    if(f == 1400)
+      AttAngle[ROLL]+= 20 * ATT_UNITS_PER_DEG;
+#endif
+
+    captureFrame(Armed);
+    loopCompute();
+    n+= testOutputs(text + n);
+
+    out[ROLL] = RxInRoll;
+    out[PITCH] = RxInPitch;
+    out[YAW] = RxInYaw;
+    for(uint8_t i = ROLL;i <= YAW;i++) {
+      bool normal = (i == ROLL ? Config.RollGyroDirection :
+        i == PITCH ? Config.PitchGyroDirection :
+        Config.YawGyroDirection) == GYRO_NORMAL;
+
+      rate[i]+= ((normal ? -out[i] : out[i]) - rate[i]) >> 4;
+    }
+  }
+  return n;
+}
+/*** END FLIGHT ***/
+
+/*
+ * Replay a record stream: the start record sets up what arming did,
+ * each frame record runs the compute stage. Returns the frames run,
+ * up to the first bad or missing record.
+ */
+static uint16_t testReplay(const uint8_t *b, size_t length, char *text)
+{
+  struct captureStart start;
+  bool started = false, fresh = false;
+  uint8_t seq = 0;
+  uint16_t frames = 0;
+  size_t n = 0;
+#ifdef GYRO_MPU6050
+  int32_t angle[2] = { 0, 0 };
+#endif
+
+  text[0] = 0;
+  for(size_t i = 0;i + 4 <= length;) {
+    uint8_t type = b[i + 1], size = b[i + 2], sum = type + size;
+    const uint8_t *p = &b[i + 3];
+
+    if(b[i] != TELEMETRY_SYNC || i + size + 4 > length)
+      break;
+    for(uint8_t j = 0;j < size;j++)
+      sum+= p[j];
+    if(sum != p[size])
+      break;
+    i+= size + 4;
+
+    if(type == TELEMETRY_CAPTURE_START) {
+      if(p[0] + size - 1 > sizeof(start))
+        break;
+      memcpy((uint8_t *)&start + p[0], p + 1, size - 1);
+      if(p[0] == 0) {
+        started = true;
+        fresh = true;
+        seq = 0;
+      }
+    } else if(type == TELEMETRY_CAPTURE_FRAME && started) {
+      struct captureFrame frame;
+
+      if(size > sizeof(frame))
+        break;
+      memcpy(&frame, p, size);
+      if((frame.seq & CAPTURE_SEQ_MASK) != (seq++ & CAPTURE_SEQ_MASK))
+        break;
+      if(fresh) {
+        fresh = false;
+        Config = start.config;
+        for(uint8_t a = ROLL;a <= YAW;a++) {
+          GainInADC[a] = start.gain[a];
+          GainPotADC[a] = start.pot[a];
+        }
+        mixerSetup();
+        sticksBuildCurves();
+        tpaBuildTable();
+        loopReset();
+      }
+
+      Armed = frame.seq & CAPTURE_ARMED;
+      RxInRoll = frame.rx[0];
+      RxInPitch = frame.rx[1];
+      RxInCollective = frame.rx[2];
+      RxInYaw = frame.rx[3];
+      RxInOrgPitch = RxInPitch >> 1;
+      for(uint8_t a = ROLL;a <= YAW;a++)
+        gyroADC[a] = frame.gyro[a];
+#ifdef GYRO_MPU6050
+      AttLevel = frame.seq & CAPTURE_LEVEL;
+      for(uint8_t a = 0;a < 2;a++) {
+        if(size == sizeof(frame))
+          angle[a] = frame.angle.whole[a];
+        else
+          angle[a]+= frame.angle.change[a];
+        AttAngle[a] = angle[a];
+      }
+#endif
+      loopCompute();
+      n+= testOutputs(text + n);
+      text[n] = 0;
+      frames++;
+    }
+  }
+  return frames;
+}
+
+/*
+ * The line number of the first difference, 0 if none.
+ */
+static uint16_t testDiff(const char *a, const char *b)
+{
+  uint16_t line = 1;
+
+  for(;*a && *a == *b;a++, b++) {
+    if(*a == '\n')
+      line++;
+  }
+  return *a || *b ? line : 0;
+}
+
+static char *testRead(const char *name, size_t *length)
+{
+  FILE *f = fopen(name, "rb");
+  char *b = calloc(1, TEST_FRAMES * TEST_LINE + TEST_STREAM + 1);
+
+  *length = f ? fread(b, 1, TEST_FRAMES * TEST_LINE + TEST_STREAM, f) : 0;
+  if(f)
+    fclose(f);
+  return b;
+}
+
+static void testWrite(const char *name, const void *b, size_t length)
+{
+  FILE *f = fopen(name, "wb");
+
+  HOST_CHECK(f && fwrite(b, 1, length, f) == length);
+  if(f)
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+  char *flown = calloc(1, TEST_FRAMES * TEST_LINE + 1);
+  char *replayed = calloc(1, TEST_FRAMES * TEST_LINE + 1);
+  char *capture, *golden;
+  size_t flownLength, captureLength, length;
+  uint16_t diff;
+
+  // The flight, and its capture replayed straight away
+  flownLength = testFly(flown);
+  HOST_CHECK(TelemetryDropped == 0);
+  HOST_CHECK(testReplay(testStream, testStreamLength, replayed) == TEST_FRAMES);
+  diff = testDiff(flown, replayed);
+  if(diff)
+    printf("%s: in-memory replay differs at frame %u\n", TEST_NAME, diff - 1);
+  HOST_CHECK(!diff);
+
+  if(argc > 1 && !strcmp(argv[1], "record")) {
+    testWrite(TEST_FIXTURE ".cap", testStream, testStreamLength);
+    testWrite(TEST_FIXTURE ".out", flown, flownLength);
+    return hostDone(TEST_NAME " record");
+  }
+
+  // The stored capture against the stored outputs
+  capture = testRead(TEST_FIXTURE ".cap", &captureLength);
+  golden = testRead(TEST_FIXTURE ".out", &length);
+  HOST_CHECK(testReplay((uint8_t *)capture, captureLength, replayed) == TEST_FRAMES);
+  diff = testDiff(golden, replayed);
+  if(diff)
+    printf("%s: %s.out differs at frame %u\n", TEST_NAME, TEST_FIXTURE, diff - 1);
+  HOST_CHECK(!diff);
+  return hostDone(TEST_NAME);
+}
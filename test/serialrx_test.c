@@ -0,0 +1,240 @@
+/*
+ * Serial Rx decoders (serialrx.c) on byte-stream fixtures: frames are
+ * fed a byte at a time through the UART interrupt, at the line rate,
+ * and checked through serialRxWidth() as RxGetChannels() reads them.
+ * Built once per protocol (see Makefile).
+ */
+#include "serialrx.h"
+
+#include <string.h>
+
+#include "receiver.h"
+
+void USART_RX_vect(void);
+
+/*** BEGIN DEFINES ***/
+#if RX_MODE == RX_SBUS
+#define TEST_NAME "serialrx SBUS"
+#define TEST_BYTE_TICKS (120 * 8)    // 12 bits at 100000 baud
+#define TEST_FRAME_TICKS (7000 * 8)
+#elif defined(SPEKTRUM_11BIT)
+#define TEST_NAME "serialrx Spektrum 2048"
+#define TEST_BYTE_TICKS (87 * 8)     // 10 bits at 115200 baud
+#define TEST_FRAME_TICKS (11000 * 8)
+#else
+#define TEST_NAME "serialrx Spektrum 1024"
+#define TEST_BYTE_TICKS (87 * 8)
+#define TEST_FRAME_TICKS (22000 * 8)
+#endif
+/*** END DEFINES ***/
+
+static const uint8_t testMap[] =
+#if RX_MODE == RX_SBUS
+  SBUS_CHANNEL_MAP;
+#else
+  SPEKTRUM_CHANNEL_MAP;
+#endif
+
+/*
+ * One byte on the line, `status` as UCSR0A has it.
+ */
+static void testByte(uint8_t b, uint8_t status)
+{
+  HostTicks+= TEST_BYTE_TICKS;
+  UCSR0A = status;
+  UDR0 = b;
+  hostIsr(USART_RX_vect);
+}
+
+static void testFrame(const uint8_t *b, uint8_t size)
+{
+  HostTicks+= TEST_FRAME_TICKS - size * TEST_BYTE_TICKS;
+  for(uint8_t i = 0;i < size;i++)
+    testByte(b[i], 0);
+}
+
+/*
+ * Check our channels against the protocol values they map from.
+ */
+static void testWidths(const uint16_t *value)
+{
+  for(uint8_t i = 0;i < RX_CHANNELS;i++) {
+    uint16_t v = value[testMap[i]];
+
+#if RX_MODE == RX_SBUS
+    HOST_CHECK(serialRxWidth(i) == v * 5 + 880 * 8);
+#elif defined(SPEKTRUM_11BIT)
+    HOST_CHECK(serialRxWidth(i) == v * 4 + 988 * 8);
+#else
+    HOST_CHECK(serialRxWidth(i) == v * 8 + 988 * 8);
+#endif
+  }
+}
+
+#if RX_MODE == RX_SBUS
+/*
+ * 16 x 11 bits, least significant first, then flags and end byte.
+ */
+static void testSbus(uint8_t *b, const uint16_t *value, uint8_t flags)
+{
+  uint32_t bits = 0;
+  uint8_t count = 0, n = 1;
+
+  memset(b, 0, SBUS_FRAME_SIZE);
+  b[0] = SBUS_START_BYTE;
+  for(uint8_t i = 0;i < 16;i++) {
+    bits|= (uint32_t)value[i] << count;
+    for(count+= 11;count >= 8;count-= 8) {
+      b[n++] = bits;
+      bits>>= 8;
+    }
+  }
+  b[23] = flags;
+}
+
+static void testProtocol(void)
+{
+  uint8_t b[SBUS_FRAME_SIZE];
+  uint16_t v1[16], v2[16];
+  uint8_t frames;
+
+  for(uint8_t i = 0;i < 16;i++) {
+    v1[i] = 172 + i * 100;           // 172..1672 of 0..2047
+    v2[i] = 1811 - i * 37;
+  }
+
+  // A frame is published at its end byte
+  testSbus(b, v1, 0);
+  testFrame(b, SBUS_FRAME_SIZE - 1);
+  HOST_CHECK(SerialRxFrames == 0);
+  testByte(b[SBUS_FRAME_SIZE - 1], 0);
+  HOST_CHECK(SerialRxFrames == 1);
+  HOST_CHECK(SerialRxFrameTime == (uint16_t)HostTicks);
+  HOST_CHECK(memcmp(SerialRxChannel[SerialRxFront], v1, sizeof(v1)) == 0);
+  testWidths(v1);
+
+  // Lost and failsafe frames are counted and not published
+  testSbus(b, v2, SBUS_FLAG_FRAME_LOST);
+  testFrame(b, SBUS_FRAME_SIZE);
+  testSbus(b, v2, SBUS_FLAG_FAILSAFE);
+  testFrame(b, SBUS_FRAME_SIZE);
+  HOST_CHECK(SerialRxFrames == 1);
+  HOST_CHECK(SerialRxLost == 2);
+  testWidths(v1);
+
+  // A bad start byte loses the frame
+  testSbus(b, v2, 0);
+  b[0] = 0x0e;
+  testFrame(b, SBUS_FRAME_SIZE);
+  HOST_CHECK(SerialRxFrames == 1);
+  HOST_CHECK(SerialRxErrors == 1);
+
+  // So does a framing error, until the next gap
+  testSbus(b, v2, 0);
+  HostTicks+= TEST_FRAME_TICKS;
+  for(uint8_t i = 0;i < SBUS_FRAME_SIZE;i++)
+    testByte(b[i], i == 5 ? _BV(FE0) : 0);
+  HOST_CHECK(SerialRxFrames == 1);
+  HOST_CHECK(SerialRxErrors == 2);
+  testWidths(v1);
+
+  // A frame cut short resyncs at the gap before the next one
+  testFrame(b, 10);
+  testFrame(b, SBUS_FRAME_SIZE);
+  HOST_CHECK(SerialRxFrames == 2);
+  testWidths(v2);
+
+  // Back to back frames
+  frames = SerialRxFrames;
+  for(uint8_t i = 0;i < 10;i++) {
+    testSbus(b, i & 1 ? v2 : v1, 0);
+    testFrame(b, SBUS_FRAME_SIZE);
+    HOST_CHECK(SerialRxFrames == (uint8_t)(frames + i + 1));
+    testWidths(i & 1 ? v2 : v1);
+  }
+}
+#else
+#ifdef SPEKTRUM_11BIT
+#define TEST_ID_SHIFT 11
+#else
+#define TEST_ID_SHIFT 10
+#endif
+
+/*
+ * Fades, system, then `count` channel words from id `first`; unused
+ * words are 0xffff.
+ */
+static void testSpektrum(uint8_t *b, const uint16_t *value, uint8_t first,
+  uint8_t count)
+{
+  memset(b, 0xff, SPEKTRUM_FRAME_SIZE);
+  b[0] = 0;
+  b[1] = 0x12;
+  for(uint8_t i = 0;i < count;i++) {
+    uint16_t w = ((uint16_t)(first + i) << TEST_ID_SHIFT) | value[first + i];
+
+    b[2 + i * 2] = w >> 8;
+    b[3 + i * 2] = w;
+  }
+}
+
+static void testProtocol(void)
+{
+  uint8_t b[SPEKTRUM_FRAME_SIZE];
+  uint16_t v1[16], v2[16];
+
+  for(uint8_t i = 0;i < 16;i++) {
+    v1[i] = (100 + i * 50) << (TEST_ID_SHIFT - 10);
+    v2[i] = (900 - i * 40) << (TEST_ID_SHIFT - 10);
+  }
+
+  // All channels in one frame
+  testSpektrum(b, v1, 0, 7);
+  testFrame(b, SPEKTRUM_FRAME_SIZE - 1);
+  HOST_CHECK(SerialRxFrames == 0);
+  testByte(b[SPEKTRUM_FRAME_SIZE - 1], 0);
+  HOST_CHECK(SerialRxFrames == 1);
+  HOST_CHECK(SerialRxFrameTime == (uint16_t)HostTicks);
+  testWidths(v1);
+
+  /*
+   * More than 7 channels come in two frames: 0-6, then 7 on. Each
+   * frame leaves the channels it does not carry as they were, through
+   * both buffers (2 frames per buffer round).
+   */
+  for(uint8_t i = 0;i < 6;i++) {
+    const uint16_t *v = i & 2 ? v2 : v1;
+
+    testSpektrum(b, v, i & 1 ? 7 : 0, i & 1 ? 2 : 7);
+    testFrame(b, SPEKTRUM_FRAME_SIZE);
+    HOST_CHECK(SerialRxFrames == 2 + i);
+    testWidths(v);
+    HOST_CHECK(SerialRxChannel[SerialRxFront][7] ==
+      (i == 0 ? 0 : (i - 1) & 2 ? v2[7] : v1[7]));
+  }
+
+  // Line errors drop the frame until the next gap
+  testSpektrum(b, v2, 0, 7);
+  HostTicks+= TEST_FRAME_TICKS;
+  for(uint8_t i = 0;i < SPEKTRUM_FRAME_SIZE;i++)
+    testByte(b[i], i == 9 ? _BV(DOR0) : 0);
+  HOST_CHECK(SerialRxFrames == 7);
+  HOST_CHECK(SerialRxErrors == 1);
+  testWidths(v1);
+
+  // A frame cut short resyncs at the gap before the next one
+  testFrame(b, 5);
+  testFrame(b, SPEKTRUM_FRAME_SIZE);
+  HOST_CHECK(SerialRxFrames == 8);
+  testWidths(v2);
+}
+#endif
+
+int main(void)
+{
+  HostTickStep = 0;
+  serialRxSetup();
+  testProtocol();
+  HOST_CHECK(HostUnguarded == 0);
+  return hostDone(TEST_NAME);
+}
@@ -0,0 +1,95 @@
+/*
+ * Settings load (Initial_EEPROM_Config_Load() in settings.c) over
+ * what other firmware left in the EEPROM: nothing, the same build's
+ * settings, another build profile's (a different SETTINGS_LAYOUT,
+ * which must keep the fixed part, frame type included, and default
+ * the rest), and an older version's (all defaults).
+ */
+#include "settings.h"
+
+#include <string.h>
+#include <avr/eeprom.h>
+
+/*** BEGIN DEFINES ***/
+#define TEST_START ((uint8_t *)EEPROM_DATA_START_POS)
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What settings.c needs from the rest of the firmware
+void motorsStopFrame(void)
+{
+  hostDelay(1e6 / ESC_RATE);
+}
+
+static struct config testDefaults;
+/*** END VARIABLES ***/
+
+/*
+ * Settings unlike the defaults in every part.
+ */
+static void testCustom(void)
+{
+  Config.FrameType = FRAME_HEX;
+  Config.StickRate[ROLL] = 77;
+  Config.OutputRate[3] = 200;
+  Config.RxMin[0] = 1111 * 8;
+#ifdef GYRO_NOTCH
+  Config.NotchFreq[2] = 150;
+#endif
+#ifdef AUTOTUNE
+  Config.TunedGain[PITCH] = 42;
+#endif
+}
+
+/*
+ * What the EEPROM holds, against what is loaded from it: both must
+ * be Config, with the version and layout of this build.
+ */
+static void testLoaded(void)
+{
+  struct config saved;
+
+  eeprom_read_block(&saved, TEST_START, sizeof(saved));
+  HOST_CHECK(!memcmp(&saved, &Config, sizeof(saved)));
+  HOST_CHECK(Config.setup == SETTINGS_VERSION);
+  HOST_CHECK(Config.layout == SETTINGS_LAYOUT);
+}
+
+int main(void)
+{
+  // Blank: the defaults, written
+  memset(HostEeprom, 0xff, sizeof(HostEeprom));
+  Initial_EEPROM_Config_Load();
+  testLoaded();
+  testDefaults = Config;
+
+  // This build's own settings come back as they were
+  testCustom();
+  Save_Config_to_EEPROM();
+  memset(&Config, 0, sizeof(Config));
+  Initial_EEPROM_Config_Load();
+  testLoaded();
+  HOST_CHECK(Config.FrameType == FRAME_HEX);
+  HOST_CHECK(Config.RxMin[0] == 1111 * 8);
+
+  // Another profile's: the fixed part stays, the rest is defaults
+  eeprom_write_byte(TEST_START + offsetof(struct config, layout), SETTINGS_LAYOUT ^ 0x30);
+  memset(&Config, 0, sizeof(Config));
+  Initial_EEPROM_Config_Load();
+  testLoaded();
+  HOST_CHECK(Config.FrameType == FRAME_HEX);
+  HOST_CHECK(Config.StickRate[ROLL] == 77);
+  HOST_CHECK(Config.OutputRate[3] == 200);
+  HOST_CHECK(!memcmp((uint8_t *)&Config + SETTINGS_FIXED,
+    (uint8_t *)&testDefaults + SETTINGS_FIXED, sizeof(Config) - SETTINGS_FIXED));
+
+  // An older version's: all defaults
+  testCustom();
+  Save_Config_to_EEPROM();
+  eeprom_write_byte(TEST_START, SETTINGS_VERSION - 1);
+  Initial_EEPROM_Config_Load();
+  testLoaded();
+  HOST_CHECK(!memcmp(&Config, &testDefaults, sizeof(Config)));
+
+  return hostDone("settings");
+}
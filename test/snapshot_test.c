@@ -0,0 +1,198 @@
+/*
+ * The Rx snapshot retry loop (rxSnapshot() in receiver.c) against an
+ * Rx interrupt at every point it can be interrupted: the snapshot is
+ * stepped an instruction at a time (hostStep()) and, once per run,
+ * the interrupt goes in at the next boundary. Every run must give a
+ * consistent snapshot, the old inputs or the new ones and never a
+ * mix, with at most one retry. Built once per receiver type (see
+ * Makefile); the PWM pin interrupts are naked assembler, so they are
+ * modelled here as they work: rising edges only write the start
+ * time, falling edges the width and then i_sreg.
+ */
+#include "../receiver.c"
+
+#include <string.h>
+
+void USART_RX_vect(void);
+
+/*** BEGIN VARIABLES ***/
+// What receiver.c needs from the rest of the firmware
+void motorsStopFrame(void) { }
+
+static uint16_t testWidth[RX_CHANNELS];
+static uint8_t testArrived;
+static uint32_t testRetried;         // Runs that took a retry
+/*** END VARIABLES ***/
+
+static void testSnapshot(void)
+{
+  testArrived = rxSnapshot(testWidth);
+}
+
+#if RX_MODE == RX_PWM
+/*** BEGIN PWM ***/
+#define TEST_S0 (1000 * 8)           // Last pulse on roll, delivered
+#define TEST_W0 (1500 * 8)
+#define TEST_S1 (5000 * 8)           // Roll pulse ending in the test
+#define TEST_W1 (1200 * 8)
+#define TEST_P0 (TEST_S0 + TEST_W0)  // Pitch pulse, delivered
+#define TEST_PW (1700 * 8)
+
+/*
+ * The roll pulse ends and the pitch one starts, as from a receiver
+ * that sends its channels one after the other.
+ */
+static void testEdges(void)
+{
+  PIND&= ~_BV(1);                    // PCINT2: roll falls
+  RxChannel1 = TCNT1 - RxChannel1Start;
+  i_sreg = 0x02;                     // SREG in the handler: I is clear
+  PIND|= _BV(2);                     // INT0: pitch rises
+  RxChannel2Start = TCNT1;
+}
+
+static void testReset(void)
+{
+  HostTicks = TEST_S1 + TEST_W1;
+  PIND = _BV(1);                     // Roll high, pitch low
+  RxChannel1Start = TEST_S1;
+  RxChannel1 = TEST_W0;
+  rxChannel[0].lastStart = TEST_S0;
+  RxChannel2Start = TEST_P0;
+  RxChannel2 = TEST_PW;
+  rxChannel[1].lastStart = TEST_P0;
+  RxRetryMax = 0;
+}
+
+/*
+ * Roll may only arrive with the width of the pulse its start belongs
+ * to, and pitch has nothing new: it is high.
+ */
+static void testCheck(void)
+{
+  if(testArrived & _BV(0)) {
+    HOST_CHECK(rxChannel[0].lastStart == TEST_S1);
+    HOST_CHECK(testWidth[0] == TEST_W1);
+  }
+  HOST_CHECK(!(testArrived & _BV(1)));
+  HOST_CHECK(RxRetryMax <= 1);
+  if(RxRetryMax)
+    testRetried++;
+
+  // What this one missed, the next one has
+  testSnapshot();
+  HOST_CHECK(rxChannel[0].lastStart == TEST_S1);
+  HOST_CHECK(testWidth[0] == TEST_W1);
+  HOST_CHECK(testWidth[1] == TEST_PW);
+  HOST_CHECK(!(testArrived & _BV(1)));
+}
+/*** END PWM ***/
+#else
+/*** BEGIN SBUS ***/
+static uint8_t testFrameA[SBUS_FRAME_SIZE], testFrameB[SBUS_FRAME_SIZE];
+static uint16_t testTimeA, testTimeB;
+
+static void testByte(uint8_t b)
+{
+  HostTicks+= 120 * 8;
+  UCSR0A = 0;
+  UDR0 = b;
+  USART_RX_vect();
+}
+
+/*
+ * All channels at `value`; SBUS packs 16 x 11 bits.
+ */
+static void testPack(uint8_t *b, uint16_t value)
+{
+  uint32_t bits = 0;
+  uint8_t count = 0, n = 1;
+
+  memset(b, 0, SBUS_FRAME_SIZE);
+  b[0] = SBUS_START_BYTE;
+  for(uint8_t i = 0;i < 16;i++) {
+    bits|= (uint32_t)value << count;
+    for(count+= 11;count >= 8;count-= 8) {
+      b[n++] = bits;
+      bits>>= 8;
+    }
+  }
+}
+
+// The end byte of frame B
+static void testEnd(void)
+{
+  testByte(testFrameB[SBUS_FRAME_SIZE - 1]);
+  testTimeB = HostTicks;
+}
+
+/*
+ * Frame A published, frame B in but for its end byte.
+ */
+static void testReset(void)
+{
+  HostTicks+= 7000 * 8;
+  for(uint8_t i = 0;i < SBUS_FRAME_SIZE;i++)
+    testByte(testFrameA[i]);
+  testTimeA = HostTicks;
+  testSnapshot();
+  HostTicks+= 4000 * 8;
+  for(uint8_t i = 0;i < SBUS_FRAME_SIZE - 1;i++)
+    testByte(testFrameB[i]);
+  RxRetryMax = 0;
+}
+
+/*
+ * Every channel and the frame time from one frame.
+ */
+static void testCheck(void)
+{
+  bool b = testWidth[0] == 300 * 5 + 880 * 8;
+
+  for(uint8_t i = 0;i < RX_CHANNELS;i++)
+    HOST_CHECK(testWidth[i] == (b ? 300 : 1700) * 5 + 880 * 8);
+  HOST_CHECK(rxFrameTime == (b ? testTimeB : testTimeA));
+  HOST_CHECK(RxRetryMax <= 1);
+  if(RxRetryMax)
+    testRetried++;
+
+  testSnapshot();
+  HOST_CHECK(testArrived == (b ? 0 : (1 << RX_CHANNELS) - 1));
+  HOST_CHECK(testWidth[0] == 300 * 5 + 880 * 8);
+  HOST_CHECK(rxFrameTime == testTimeB);
+}
+/*** END SBUS ***/
+#endif
+
+int main(void)
+{
+  uint32_t steps;
+
+  HostTickStep = 0;
+#if RX_MODE == RX_PWM
+  void (*isr)(void) = testEdges;
+#else
+  void (*isr)(void) = testEnd;
+
+  serialRxSetup();
+  testPack(testFrameA, 1700);
+  testPack(testFrameB, 300);
+#endif
+  sei();
+
+  testReset();
+  steps = hostStep(testSnapshot, UINT32_MAX, NULL);
+  HOST_CHECK(steps > 10);
+
+  for(uint32_t at = 0;at <= steps;at++) {
+    testReset();
+    hostStep(testSnapshot, at, isr);
+    if(!hostStepFired())
+      hostIsr(isr);                  // Not reached: after the snapshot
+    testCheck();
+  }
+
+  printf("%u boundaries, %u retried\n", steps, testRetried);
+  HOST_CHECK(testRetried > 0);
+  return hostDone(RX_MODE == RX_PWM ? "snapshot PWM" : "snapshot SBUS");
+}
@@ -0,0 +1,183 @@
+/*
+ * Rate stabilizer (stabilizer.c). Built twice (see Makefile): with the
+ * defaults, which must give the loops the firmware always had, and
+ * with feed-forward on.
+ *
+ * The laws: untuned roll and pitch are P only and pass any error as
+ * it is; untuned yaw and tuned axes clamp it to STAB_ERROR_MAX; a
+ * stick step gives untuned yaw no derivative kick.
+ *
+ * The step test: roll on a simulated airframe (motor lag driving
+ * inertia with drag, as in autotune_test.c), a stick step smoothed
+ * over the frames between receiver updates. The feedback is the same
+ * P gain either way; feed-forward must reach 90% of the final rate
+ * sooner than the P-only loop, and not overshoot it by much.
+ */
+#include "stabilizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "gyros.h"
+#include "mixer.h"
+#include "settings.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_DT (1.0 / ESC_RATE)
+#define TEST_SUBSTEPS 10
+#define TEST_MOTOR_TAU 0.03          // s
+#define TEST_DRAG_TAU 0.5            // s
+#define TEST_GAIN 40.0               // Gyro units per s^2 per output unit
+#define TEST_STICK 200               // Step, setpoint units
+#define TEST_SMOOTH 9                // Frames per receiver update
+#define TEST_FRAMES ESC_RATE
+#define TEST_IMAX 200
+
+#if STAB_FF_ROLL > 0
+#define TEST_NAME "stabilizer FF"
+#else
+#define TEST_NAME "stabilizer"
+#endif
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What stabilizer.c needs from the rest of the firmware
+struct config Config;
+uint8_t MixerSaturated;
+
+struct testStep {
+  uint16_t rise;                     // Frames to 90% of the final rate
+  double overshoot;                  // Past it, fraction of it
+  double final;
+};
+/*** END VARIABLES ***/
+
+/*
+ * Untuned roll and pitch: out = sp - gyro, whatever the error.
+ */
+static void testPOnly(void)
+{
+  static const int16_t sp[] = { 0, 300, -700, 1500, -2000, 900 };
+  static const int16_t gyro[] = { 0, -900, 800, -1200, 1500, 0 };
+
+  stabilizerReset();
+  for(uint8_t i = 0;i < sizeof(sp) / sizeof(sp[0]);i++) {
+    HOST_CHECK(stabilizerApply(ROLL, sp[i], gyro[i], TEST_IMAX) == sp[i] - gyro[i]);
+    HOST_CHECK(stabilizerApply(PITCH, -sp[i], gyro[i], TEST_IMAX) == -sp[i] - gyro[i]);
+  }
+}
+
+/*
+ * Untuned yaw: the stick once more, the error clamped, I over 16 up
+ * to imax. The gyro stays put, so there is no D; and moving the stick
+ * gives none either, as D is on the gyro only.
+ */
+static void testYaw(void)
+{
+  int16_t integral = 0;
+
+  stabilizerReset();
+  for(int16_t sp = -2000;sp <= 2000;sp+= 250) {
+    int16_t gyro = -sp / 4;
+    int16_t e = sp - gyro;
+
+    stabilizerReset();
+    integral = 0;
+    for(uint8_t i = 0;i < 3;i++) {
+      if(e > STAB_ERROR_MAX)
+        e = STAB_ERROR_MAX;
+      else if(e < -STAB_ERROR_MAX)
+        e = -STAB_ERROR_MAX;
+      integral+= e;
+      if(integral > TEST_IMAX)
+        integral = TEST_IMAX;
+      else if(integral < -TEST_IMAX)
+        integral = -TEST_IMAX;
+      HOST_CHECK(stabilizerApply(YAW, sp, gyro, TEST_IMAX) ==
+        sp + e + (integral >> 4));
+    }
+  }
+}
+
+/*
+ * Tuned axes, with no I or D: the clamped error, as pid_tuned() gave.
+ * The stick stays put, so this holds with feed-forward too.
+ */
+static void testTuned(void)
+{
+  memset(&Config, 0, sizeof(Config));
+  for(uint8_t axis = ROLL;axis <= YAW;axis++)
+    Config.TunedGain[axis] = 100;
+  stabilizerReset();
+  for(uint8_t axis = ROLL;axis <= YAW;axis++) {
+    HOST_CHECK(stabilizerApply(axis, 400, -1500, TEST_IMAX) == STAB_ERROR_MAX);
+    HOST_CHECK(stabilizerApply(axis, 400, 1900, TEST_IMAX) == -STAB_ERROR_MAX);
+    HOST_CHECK(stabilizerApply(axis, 400, 100, TEST_IMAX) == 300);
+  }
+  memset(&Config, 0, sizeof(Config));
+}
+
+/*
+ * Roll stick step on the airframe; `reference` runs the P-only law
+ * the firmware always had instead of the stabilizer.
+ */
+static struct testStep testStep(bool reference)
+{
+  struct testStep r = { 0, 0, 0 };
+  double rate = 0, motor = 0, rates[TEST_FRAMES];
+  int16_t out = 0, sp = 0;
+
+  stabilizerReset();
+  for(uint16_t f = 0;f < TEST_FRAMES;f++) {
+    int16_t gyro = lround(rate);
+
+    // A receiver update every TEST_SMOOTH frames, ramped in between
+    if(f < TEST_SMOOTH * 4)
+      sp = (int32_t)TEST_STICK * (f / TEST_SMOOTH) / 4 +
+        (int32_t)TEST_STICK * (f % TEST_SMOOTH) / (4 * TEST_SMOOTH);
+    else
+      sp = TEST_STICK;
+
+    for(uint8_t s = 0;s < TEST_SUBSTEPS;s++) {
+      double h = TEST_DT / TEST_SUBSTEPS;
+
+      motor+= (out - motor) * h / TEST_MOTOR_TAU;
+      rate+= (TEST_GAIN * motor - rate / TEST_DRAG_TAU) * h;
+    }
+    out = reference ? sp - gyro : stabilizerApply(ROLL, sp, gyro, TEST_IMAX);
+    rates[f] = rate;
+  }
+
+  r.final = rates[TEST_FRAMES - 1];
+  for(uint16_t f = 0;f < TEST_FRAMES;f++) {
+    if(!r.rise && rates[f] >= 0.9 * r.final)
+      r.rise = f + 1;
+    if(rates[f] / r.final - 1 > r.overshoot)
+      r.overshoot = rates[f] / r.final - 1;
+  }
+  return r;
+}
+
+int main(void)
+{
+  struct testStep ref, step;
+
+  testTuned();
+#if STAB_FF_ROLL == 0
+  testPOnly();
+  testYaw();
+#endif
+
+  ref = testStep(true);
+  step = testStep(false);
+  printf("%s: 90%% in %u frames (P only %u), overshoot %.1f%% (%.1f%%)\n",
+    TEST_NAME, step.rise, ref.rise, step.overshoot * 100, ref.overshoot * 100);
+  HOST_CHECK(fabs(step.final - ref.final) < 0.01 * ref.final);
+#if STAB_FF_ROLL > 0
+  HOST_CHECK(step.rise < ref.rise);
+  HOST_CHECK(step.overshoot < ref.overshoot + 0.1);
+#else
+  HOST_CHECK(step.rise == ref.rise);
+#endif
+  return hostDone(TEST_NAME);
+}
@@ -0,0 +1,65 @@
+/*
+ * Stick curves (sticks.h, sticks.c): sticksApply() against the curve
+ * it tables, over the whole -STICK_FULL..STICK_FULL throw, at full
+ * expo where the interpolation is furthest off. The table must end
+ * just past full deflection, inputs beyond it must clamp, and the
+ * curve must be odd-symmetric.
+ */
+#include "sticks.h"
+
+#include <math.h>
+
+#include "gyros.h"
+#include "settings.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_POT 500
+#define TEST_ERROR 0.01              // Of the full deflection output
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What sticks.c needs from the rest of the firmware
+struct config Config;
+uint16_t GainPotADC[3];
+/*** END VARIABLES ***/
+
+/*
+ * The curve sticksBuildCurves() tables, at x.
+ */
+static double testCurve(uint8_t axis, double x)
+{
+  double rate = Config.StickRate[axis] / 100.0, expo = Config.StickExpo[axis] / 100.0;
+  double y = x * (1 - expo) + expo * x * x * x / ((double)STICK_FULL * STICK_FULL);
+
+  return y * rate * GainPotADC[axis] / (1 << STICK_GAIN_SHIFT);
+}
+
+int main(void)
+{
+  double worst = 0, full;
+
+  for(uint8_t i = ROLL;i <= YAW;i++) {
+    Config.StickRate[i] = STICK_RATE_DEFAULT;
+    Config.StickExpo[i] = STICK_EXPO_MAX;
+    GainPotADC[i] = TEST_POT;
+  }
+  sticksBuildCurves();
+  HOST_CHECK((STICK_CURVE_POINTS - 2) << STICK_CURVE_SHIFT < STICK_FULL);
+  HOST_CHECK((STICK_CURVE_POINTS - 1) << STICK_CURVE_SHIFT >= STICK_FULL);
+
+  full = testCurve(ROLL, STICK_FULL);
+  for(int16_t x = -STICK_FULL;x <= STICK_FULL;x++) {
+    double e = fabs(sticksApply(ROLL, x) - testCurve(ROLL, x)) / full;
+
+    if(e > worst)
+      worst = e;
+    HOST_CHECK(sticksApply(ROLL, -x) == -sticksApply(ROLL, x));
+  }
+  printf("sticks: %u points, within %.2f%% of the curve at full expo\n",
+    STICK_CURVE_POINTS, worst * 100);
+  HOST_CHECK(worst < TEST_ERROR);
+
+  HOST_CHECK(sticksApply(ROLL, STICK_FULL + 300) == sticksApply(ROLL, STICK_FULL));
+  HOST_CHECK(sticksApply(ROLL, -STICK_FULL - 300) == -sticksApply(ROLL, STICK_FULL));
+  return hostDone("sticks");
+}
@@ -0,0 +1,147 @@
+/*
+ * Tricopter tail (mixerPostTri() in mixer.c) in a yaw step. The tail
+ * servo is simulated as it is driven: a new pulse only every SERVO_RATE
+ * frame, and a servo that moves at most TRI_THROW per TRI_SERVO_MS,
+ * slowing down TEST_SERVO_TAU before it gets there. The step is run
+ * with the mixer's servo lead and without it (the servo fed the stick
+ * mix as it is); the lead must bring the servo there sooner and not
+ * overshoot much. The tail motor's lift, its output times the cosine
+ * of the real tilt, must stay where it was once the servo is there.
+ * Also checks the boost table against 1 / cos.
+ */
+#include "mixer.h"
+
+#include <math.h>
+
+#include "motors.h"
+#include "settings.h"
+
+/*** BEGIN DEFINES ***/
+#define TEST_DT (1.0 / ESC_RATE)
+#define TEST_SUBSTEPS 10
+#define TEST_SERVO_TAU 0.02          // s
+#define TEST_COLLECTIVE 500
+#define TEST_YAW 300                 // Step, output units
+#define TEST_STEP 45                 // Frame of the step
+#define TEST_FRAMES (ESC_RATE / 2)
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+// What mixer.c and motors.c need from the rest of the firmware
+int16_t RxInRoll, RxInPitch, RxInCollective, RxInYaw, RxInOrgPitch;
+void RxGetChannels(void) { }
+
+struct testRun {
+  uint16_t rise;                     // Frames to 90%, counting the step's
+  double overshoot;                  // Past the step, fraction of it
+  double lift;                       // Worst tail lift error when there
+  double droop;                      // The same, without the boost
+};
+/*** END VARIABLES ***/
+
+static double testTilt(double servo)
+{
+  return servo * TRI_SERVO_DEG / TRI_THROW * M_PI / 180;
+}
+
+/*
+ * The yaw step, through the mixer (lead) or straight to the servo.
+ */
+static struct testRun testStep(bool lead)
+{
+  struct testRun r = { 0, 0, 0, 0 };
+  struct mixerInput in = { TEST_COLLECTIVE, 0, 0, 0 };
+  uint8_t divider = MotorOutput[3].divider;
+  double servo = 0, command = 0, target = 0, rate = TRI_THROW * 1000.0 / TRI_SERVO_MS;
+  double lift0 = 0;
+
+  mixerReset();
+  for(uint16_t f = 0;f < TEST_FRAMES;f++) {
+    int16_t out;
+
+    in.yaw = f >= TEST_STEP ? TEST_YAW : 0;
+    mixerMix(&in);
+    out = MotorOut[3] - Mixer.output[3].offset;
+    target = ((int32_t)TEST_YAW * Mixer.output[3].yaw) >> MIXER_SHIFT;
+    if(f == 0)
+      lift0 = MotorOut[2];
+    if(f % divider == 0)
+      command = lead ? out : in.yaw ? target : 0;
+
+    for(uint8_t s = 0;s < TEST_SUBSTEPS;s++) {
+      double v = (command - servo) / TEST_SERVO_TAU;
+
+      if(v > rate)
+        v = rate;
+      else if(v < -rate)
+        v = -rate;
+      servo+= v * TEST_DT / TEST_SUBSTEPS;
+    }
+
+    if(f < TEST_STEP)
+      continue;
+    if(!r.rise && servo / target >= 0.9)
+      r.rise = f - TEST_STEP + 1;
+    if(servo / target - 1 > r.overshoot)
+      r.overshoot = servo / target - 1;
+    if(r.rise && f - TEST_STEP >= 2 * r.rise) {
+      double lift = MotorOut[2] * cos(testTilt(servo)) / lift0 - 1;
+      double droop = lift0 * cos(testTilt(servo)) / lift0 - 1;
+
+      if(fabs(lift) > r.lift)
+        r.lift = fabs(lift);
+      if(fabs(droop) > r.droop)
+        r.droop = fabs(droop);
+    }
+  }
+  return r;
+}
+
+/*
+ * The boost the mixer applies at each servo deflection, from the tail
+ * motor output with and without it.
+ */
+static void testBoost(void)
+{
+  double worst = 0, base = 0;
+
+  for(int16_t servo = 0;servo <= TRI_THROW;servo+= 7) {
+    struct mixerInput in = { TEST_COLLECTIVE, 0, 0, -servo };
+    double boost;
+
+    mixerReset();
+    for(uint8_t i = 0;i < 200;i++)
+      mixerMix(&in);
+    if(!servo)
+      base = MotorOut[2];
+    boost = MotorOut[2] / base * cos(testTilt(servo)) - 1;
+    if(fabs(boost) > worst)
+      worst = fabs(boost);
+  }
+  printf("boost within %.2f%% of 1 / cos\n", worst * 100);
+  HOST_CHECK(worst < 0.005);
+}
+
+int main(void)
+{
+  struct testRun lead, plain;
+
+  Set_EEPROM_Default_Config();
+  Config.FrameType = FRAME_TRI;
+  mixerSetup();
+  HOST_CHECK(Mixer.post && Mixer.outputs == 4);
+
+  lead = testStep(true);
+  plain = testStep(false);
+  printf("yaw step: 90%% in %u frames (%u without lead), overshoot %.1f%%, "
+    "lift within %.1f%% (%.1f%% unboosted)\n", lead.rise, plain.rise,
+    lead.overshoot * 100, lead.lift * 100, lead.droop * 100);
+  HOST_CHECK(lead.rise > 0 && plain.rise > 0);
+  HOST_CHECK(lead.rise < plain.rise);
+  HOST_CHECK(lead.overshoot < 0.1);
+  HOST_CHECK(lead.lift < 0.01);
+  HOST_CHECK(lead.droop > 0.03);
+
+  testBoost();
+  return hostDone("tri");
+}
@@ -0,0 +1,76 @@
+#include "timers.h"
+
+/*** BEGIN VARIABLES ***/
+static struct timer timers[TIMERS];
+static uint8_t timersFlashes;        // LED toggles to go
+/*** END VARIABLES ***/
+
+/*
+ * Count down one frame. Called from output_motor_ppm().
+ */
+void timersUpdate()
+{
+  for(uint8_t i = 0;i < TIMERS;i++) {
+    struct timer *t = &timers[i];
+
+    if(t->left && !--t->left) {
+      t->fired = true;
+      t->left = t->period;
+    }
+  }
+
+  if(timersFlashes && timersFired(TIMER_LED)) {
+    LED = !LED;
+    if(!--timersFlashes)
+      timersStop(TIMER_LED);
+  }
+}
+
+/*
+ * (Re)start a timer: it fires after `frames` frames (see TIMER_MS()),
+ * then every `period` frames if that is not 0.
+ */
+void timersStart(uint8_t id, uint16_t frames, uint16_t period)
+{
+  timers[id].left = frames ? frames : 1;
+  timers[id].period = period;
+  timers[id].fired = false;
+}
+
+void timersStop(uint8_t id)
+{
+  timers[id].left = 0;
+  timers[id].fired = false;
+}
+
+bool timersRunning(uint8_t id)
+{
+  return timers[id].left != 0;
+}
+
+/*
+ * Whether the timer has fired since the last call.
+ */
+bool timersFired(uint8_t id)
+{
+  if(!timers[id].fired)
+    return false;
+  timers[id].fired = false;
+  return true;
+}
+
+/*
+ * Flash the LED `count` times, as the setup modes do on entry. Runs
+ * from timersUpdate(); timersFlashing() is true until it is done.
+ */
+void timersFlash(uint8_t count)
+{
+  LED = 1;
+  timersFlashes = count * 2 - 1;
+  timersStart(TIMER_LED, TIMER_MS(TIMERS_FLASH_MS), TIMER_MS(TIMERS_FLASH_MS));
+}
+
+bool timersFlashing()
+{
+  return timersFlashes != 0;
+}
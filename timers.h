@@ -0,0 +1,49 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "config.h"
+#include "motors.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Software timers, counted in output frames: output_motor_ppm()
+ * calls timersUpdate() once per frame, so any loop that keeps the
+ * ESCs fed also keeps time, and nothing needs to read a hardware
+ * timer (timer2 wakes the output stage, see motors.h). A timer is
+ * one-shot or periodic; expiry sets a flag, read with timersFired().
+ */
+#define TIMER_MS(ms) ((uint16_t)(((uint32_t)(ms) * ESC_RATE + 999) / 1000))
+
+#define TIMER_LED 0                  // LED flashes (timersFlash())
+#define TIMER_MODE 1                 // Steps of the setup modes
+#define TIMER_ARMING 2               // Arming stick hold
+#define TIMER_TELEMETRY 3            // Periodic telemetry records
+#ifdef MINIMAL
+#define TIMERS 3                     // No telemetry
+#else
+#define TIMERS 4
+#endif
+
+#define TIMERS_FLASH_MS 25           // LED on and off time of a flash
+#define TIMERS_TELEMETRY_MS 1000
+/*** END DEFINES ***/
+
+/*** BEGIN TYPES ***/
+struct timer {
+  uint16_t left;                     // Frames to go, 0 = stopped
+  uint16_t period;                   // Frames, 0 = one-shot
+  bool fired;
+};
+/*** END TYPES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void timersUpdate(void);
+void timersStart(uint8_t id, uint16_t frames, uint16_t period);
+void timersStop(uint8_t id);
+bool timersRunning(uint8_t id);
+bool timersFired(uint8_t id);
+void timersFlash(uint8_t count);
+bool timersFlashing(void);
+/*** END PROTOTYPES ***/
+
+#endif
@@ -0,0 +1,62 @@
+#include "tpa.h"
+
+#include "gyros.h"
+#include "settings.h"
+
+uint16_t TpaGyroGain[3][TPA_STEPS];
+
+/*
+ * Gain (in %) of the attenuation curve of an axis at a throttle %.
+ */
+static uint8_t tpaCurve(uint8_t axis, uint8_t throttle)
+{
+  uint8_t i, x0, x1, y0, y1;
+
+  if(throttle <= Config.TpaThrottle[0])
+    return Config.TpaGain[axis][0];
+
+  for(i = 1;i < TPA_POINTS;i++) {
+    x1 = Config.TpaThrottle[i];
+    if(throttle < x1) {
+      x0 = Config.TpaThrottle[i - 1];
+      y0 = Config.TpaGain[axis][i - 1];
+      y1 = Config.TpaGain[axis][i];
+      return y0 + ((int16_t)(y1 - y0) * (throttle - x0)) / (x1 - x0);
+    }
+  }
+
+  return Config.TpaGain[axis][TPA_POINTS - 1];
+}
+
+/*
+ * Scheduled gain (in %) of an axis at a (scaled, 0-1000) collective.
+ */
+uint8_t tpaPercent(uint8_t axis, int16_t collective)
+{
+  if(collective < 0)
+    collective = 0;
+  else if(collective > 1000)
+    collective = 1000;
+  return tpaCurve(axis, collective / 10);
+}
+
+/*
+ * Rebuild the scheduled gyro gains from the gain pots and the
+ * attenuation curves. Must be called whenever Config or GainInADC[]
+ * changes; the hot path is then a single table read per axis.
+ */
+void tpaBuildTable()
+{
+  uint8_t axis, i, throttle;
+
+  for(axis = ROLL;axis <= YAW;axis++) {
+    for(i = 0;i < TPA_STEPS;i++) {
+      // Throttle % at the middle of the bucket
+      throttle = (((uint16_t)i << TPA_SHIFT) + (1 << (TPA_SHIFT - 1))) / 10;
+      if(throttle > 100)
+        throttle = 100;
+      TpaGyroGain[axis][i] =
+        ((uint32_t)GainInADC[axis] * tpaCurve(axis, throttle)) / 100;
+    }
+  }
+}
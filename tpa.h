@@ -0,0 +1,51 @@
+#ifndef TPA_H
+#define TPA_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Throttle PID attenuation (gain scheduling). The gyro gain of each
+ * axis is scaled by a piecewise-linear curve through TPA_POINTS
+ * breakpoints of (throttle %, gain %), stored in Config. Below the
+ * first and above the last breakpoint the curve is flat.
+ */
+#define TPA_POINTS 3
+
+// Default breakpoints: flat 100% (no attenuation)
+#define TPA_THROTTLE_DEFAULT_0 0
+#define TPA_THROTTLE_DEFAULT_1 50
+#define TPA_THROTTLE_DEFAULT_2 100
+#define TPA_GAIN_DEFAULT 100
+
+// Precomputed table: TPA_STEPS buckets of collective (0..1023)
+#ifdef MINIMAL
+#define TPA_SHIFT 9
+#else
+#define TPA_SHIFT 6
+#endif
+#define TPA_STEPS (1024 >> TPA_SHIFT)
+/*** END DEFINES ***/
+
+/*** BEGIN VARIABLES ***/
+extern uint16_t TpaGyroGain[3][TPA_STEPS];
+/*** END VARIABLES ***/
+
+/*** BEGIN PROTOTYPES ***/
+void tpaBuildTable(void);
+uint8_t tpaPercent(uint8_t axis, int16_t collective);
+/*** END PROTOTYPES ***/
+
+/*
+ * Table bucket for a (scaled, 0-1000) collective value.
+ */
+static inline uint8_t tpaIndex(int16_t collective)
+{
+  if(collective <= 0)
+    return 0;
+  if(collective >= 1024)
+    return TPA_STEPS - 1;
+  return collective >> TPA_SHIFT;
+}
+
+#endif
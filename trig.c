@@ -0,0 +1,48 @@
+#include "trig.h"
+
+#include <avr/pgmspace.h>
+
+/*
+ * Quarter wave cosine, 64 steps plus the end point.
+ */
+static const uint16_t trigTable[65] PROGMEM = {
+  16384, 16379, 16364, 16340, 16305, 16261, 16207, 16143,
+  16069, 15986, 15893, 15791, 15679, 15557, 15426, 15286,
+  15137, 14978, 14811, 14635, 14449, 14256, 14053, 13842,
+  13623, 13395, 13160, 12916, 12665, 12406, 12140, 11866,
+  11585, 11297, 11003, 10702, 10394, 10080, 9760, 9434,
+  9102, 8765, 8423, 8076, 7723, 7366, 7005, 6639,
+  6270, 5897, 5520, 5139, 4756, 4370, 3981, 3590,
+  3196, 2801, 2404, 2006, 1606, 1205, 804, 402,
+  0,
+};
+
+/*
+ * Cosine by table lookup with linear interpolation, good to about
+ * 1 part in 10^4. Not meant for the control loop; use it to build
+ * coefficient tables.
+ */
+int16_t trigCos(uint16_t angle)
+{
+  bool negative = false;
+  uint8_t i, f;
+  uint16_t a, b;
+
+  // Fold into the first quadrant
+  if(angle > 0x8000)
+    angle = -angle;                  // cos(-x) = cos(x)
+  if(angle > TRIG_QUARTER) {
+    angle = 0x8000 - angle;          // cos(180 - x) = -cos(x)
+    negative = true;
+  }
+
+  i = angle >> TRIG_TABLE_SHIFT;
+  f = angle & ((1 << TRIG_TABLE_SHIFT) - 1);
+  a = pgm_read_word(&trigTable[i]);
+  if(f) {
+    b = pgm_read_word(&trigTable[i + 1]);
+    a-= ((uint32_t)(a - b) * f) >> TRIG_TABLE_SHIFT;
+  }
+
+  return negative ? -(int16_t)a : a;
+}
@@ -0,0 +1,25 @@
+#ifndef TRIG_H
+#define TRIG_H
+
+#include "config.h"
+
+/*** BEGIN DEFINES ***/
+/*
+ * Fixed-point trig: angles are 16-bit fractions of a full turn
+ * (65536 = 360 degrees), results are Q14 (16384 = 1.0).
+ */
+#define TRIG_ONE 16384
+#define TRIG_QUARTER 16384           // 90 degrees
+#define TRIG_TABLE_SHIFT 8           // Angle bits per table step
+
+/*
+ * Angle for a frequency at a sample rate, both in Hz.
+ */
+#define TRIG_ANGLE(f, fs) ((uint16_t)(((uint32_t)(f) << 16) / (fs)))
+/*** END DEFINES ***/
+
+/*** BEGIN PROTOTYPES ***/
+int16_t trigCos(uint16_t angle);
+/*** END PROTOTYPES ***/
+
+#endif